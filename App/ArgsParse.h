@@ -13,6 +13,7 @@ namespace ArgsParse
 		std::string file_ext;
 		std::unordered_map<std::string, std::string> options;
 		bool required = false;
+		std::string value_name = {}; // Takes a plain value, for arguments that aren't files or options
 	};
 
 	void PrintHelp(const std::unordered_map<std::string, ArgumentDef> &def)
@@ -25,6 +26,8 @@ namespace ArgsParse
 			std::cout << "-" << arg.first;
 			if (!arg.second.file_ext.empty())
 				std::cout << " <*." << arg.second.file_ext << ">";
+			else if (!arg.second.value_name.empty())
+				std::cout << " <" << arg.second.value_name << ">";
 			std::cout << std::endl;
 			std::cout << "    " << arg.second.desc << std::endl;
 			if (!arg.second.def.empty())
@@ -81,7 +84,7 @@ namespace ArgsParse
 				}
 
 				// Check if this is a long argument
-				if (!it->second.file_ext.empty() || !it->second.options.empty())
+				if (!it->second.file_ext.empty() || !it->second.options.empty() || !it->second.value_name.empty())
 					current_arg = it;
 				else
 					args[arg];
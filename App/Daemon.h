@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+// Daemon protocol
+// Every message is a little endian 32-bit length followed by that many bytes
+// Requests start with a command byte, responses start with a status byte
+//   Compile:   command, target, flags, 32-bit name length, name, source
+//   Decompile: command, bytecode
+// Compiles with a name keep a compile cache under it between requests
+namespace Daemon
+{
+	enum class Command : uint8_t
+	{
+		Compile = 1,
+		Decompile = 2,
+	};
+
+	enum class Status : uint8_t
+	{
+		Ok = 0,
+		Error = 1,
+	};
+
+	// Compile flags
+	static constexpr uint8_t FLAG_OPTIMIZE = 1 << 0;
+	static constexpr uint8_t FLAG_LINE_NUMBERS = 1 << 1;
+
+	// Largest message accepted
+	static constexpr uint32_t MAX_MESSAGE = 64 * 1024 * 1024;
+
+	static void PutInt(std::vector<unsigned char> &data, uint32_t value)
+	{
+		data.push_back((unsigned char)((value >> 0) & 0xFF));
+		data.push_back((unsigned char)((value >> 8) & 0xFF));
+		data.push_back((unsigned char)((value >> 16) & 0xFF));
+		data.push_back((unsigned char)((value >> 24) & 0xFF));
+	}
+
+	static uint32_t GetInt(const unsigned char *data)
+	{
+		return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+	}
+
+	static bool SendAll(int fd, const unsigned char *data, size_t size)
+	{
+		while (size > 0)
+		{
+			ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+			if (sent <= 0)
+				return false;
+			data += sent;
+			size -= sent;
+		}
+		return true;
+	}
+
+	static bool ReceiveAll(int fd, unsigned char *data, size_t size)
+	{
+		while (size > 0)
+		{
+			ssize_t received = recv(fd, data, size, 0);
+			if (received <= 0)
+				return false;
+			data += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	static bool SendMessage(int fd, const std::vector<unsigned char> &message)
+	{
+		std::vector<unsigned char> header;
+		PutInt(header, (uint32_t)message.size());
+		return SendAll(fd, header.data(), header.size()) && SendAll(fd, message.data(), message.size());
+	}
+
+	static bool ReceiveMessage(int fd, std::vector<unsigned char> &message)
+	{
+		unsigned char header[4];
+		if (!ReceiveAll(fd, header, sizeof(header)))
+			return false;
+
+		uint32_t size = GetInt(header);
+		if (size > MAX_MESSAGE)
+			return false;
+
+		message.resize(size);
+		return ReceiveAll(fd, message.data(), size);
+	}
+}
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "QUtil.h"
+
+namespace Generate
+{
+	// Shapes, each one leans on a different part of the compiler
+	enum class Shape
+	{
+		Mixed, // A bit of everything
+		Nesting, // Deeply nested IF and SWITCH blocks
+		Literals, // Huge struct and array literals
+		Random, // RANDOMs with long weight lists
+		Identifiers, // Every name distinct, filling the checksum table
+		Strings, // Long strings full of escapes
+		Large, // Scripts with IF and SWITCH blocks too big for short jumps
+	};
+
+	struct Settings
+	{
+		uint64_t seed = 1;
+		size_t size = 64 * 1024; // Bytes of source to write, the last definition may run over
+		Shape shape = Shape::Mixed;
+
+		unsigned int depth = 6; // Deepest nesting of blocks and literals
+		unsigned int width = 16; // Elements in a struct or array, and weights in a RANDOM
+		size_t identifiers = 4096; // Names to pick from, the identifiers shape never reuses names
+		size_t string_length = 32;
+	};
+
+	// Small generator with a fixed algorithm, so a seed makes the same script everywhere
+	// The standard distributions are implementation defined, so they aren't used
+	struct Random
+	{
+		uint64_t state;
+
+		explicit Random(uint64_t seed) : state(seed) {}
+
+		uint64_t Next()
+		{
+			// splitmix64
+			uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		}
+
+		// Number in [0, n)
+		uint64_t Below(uint64_t n)
+		{
+			return (n == 0) ? 0 : Next() % n;
+		}
+
+		bool Chance(unsigned int percent)
+		{
+			return Below(100) < percent;
+		}
+	};
+
+	class Generator
+	{
+		private:
+			const Settings &settings;
+			Random random;
+			std::string out;
+			size_t next_name = 0;
+			std::unordered_map<uint32_t, uint64_t> checksums; // Names used so far, by checksum
+			std::string name;
+			size_t statements = 0; // Left in the script being written
+			size_t script_start = 0;
+			bool in_script = false;
+
+			// Scripts are kept small, so their IF and SWITCH blocks fit short jumps
+			// The large shape writes blocks of 48 to 96 KB instead, which have to fall back to long jumps
+			static constexpr size_t max_statements = 160;
+			static constexpr size_t max_script_size = 12 * 1024;
+			static constexpr size_t max_large_script_size = 512 * 1024;
+			static constexpr size_t min_large_block_size = 48 * 1024;
+			static constexpr size_t max_script_string_length = 256;
+
+			bool Budget() const
+			{
+				size_t script_size = (settings.shape == Shape::Large) ? max_large_script_size : max_script_size;
+				return statements > 0 && out.size() - script_start < script_size;
+			}
+
+			void Indent(unsigned int level)
+			{
+				out.append(level, '\t');
+			}
+
+			void MakeName(uint64_t id)
+			{
+				static const char *prefixes[] = { "obj", "ped", "skater", "goal", "level", "anim", "sfx", "menu", "trick", "cam" };
+				name = prefixes[id % 10];
+				name += '_';
+				name += std::to_string(id);
+			}
+
+			void Name()
+			{
+				// Names that collide with one already used are skipped, the compiler would reject them
+				while (1)
+				{
+					uint64_t id;
+					if (settings.shape == Shape::Identifiers)
+						id = next_name++;
+					else
+						id = random.Below(settings.identifiers);
+					MakeName(id);
+
+					auto find = checksums.emplace((uint32_t)QScript::CRC(name.c_str()), id).first;
+					if (find->second == id)
+						break;
+				}
+				out += name;
+			}
+
+			void Integer()
+			{
+				int64_t value = (int64_t)random.Below(2000) - 1000;
+				out += std::to_string(value);
+			}
+
+			void Float()
+			{
+				out += std::to_string(random.Below(1000));
+				out += '.';
+				out += std::to_string(random.Below(100));
+			}
+
+			void String()
+			{
+				size_t string_length = in_script ? std::min(settings.string_length, max_script_string_length) : settings.string_length;
+				size_t length = string_length / 2 + random.Below(string_length + 1);
+				unsigned int escapes = (settings.shape == Shape::Strings) ? 20 : 4;
+
+				out += '"';
+				for (size_t i = 0; i < length; i++)
+				{
+					if (random.Chance(escapes))
+					{
+						static const char *sequences[] = { "\\n", "\\t", "\\\\", "\\\"", "\\101", "\\r" };
+						out += sequences[random.Below(6)];
+					}
+					else
+					{
+						static const char characters[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 .,:;!?-_()[]{}<>/'";
+						out += characters[random.Below(sizeof(characters) - 1)];
+					}
+				}
+				out += '"';
+			}
+
+			void Value(unsigned int level, unsigned int depth)
+			{
+				unsigned int kinds = (depth < settings.depth) ? 9 : 7;
+				switch (random.Below(kinds))
+				{
+					case 0:
+					case 1:
+						Integer();
+						break;
+					case 2:
+						Float();
+						break;
+					case 3:
+						String();
+						break;
+					case 4:
+						Name();
+						break;
+					case 5:
+						out += "VECTOR(";
+						Float();
+						out += ", ";
+						Float();
+						out += ", ";
+						Float();
+						out += ')';
+						break;
+					case 6:
+						out += "PAIR(";
+						Float();
+						out += ", ";
+						Float();
+						out += ')';
+						break;
+					case 7:
+						Struct(level, depth + 1, 1 + (unsigned int)random.Below(4));
+						break;
+					case 8:
+						Array(depth + 1, 1 + (unsigned int)random.Below(6));
+						break;
+				}
+			}
+
+			void Struct(unsigned int level, unsigned int depth, unsigned int width)
+			{
+				out += "{\n";
+				for (unsigned int i = 0; i < width; i++)
+				{
+					Indent(level + 1);
+					Name();
+					out += " = ";
+					Value(level + 1, depth);
+					out += '\n';
+				}
+				Indent(level);
+				out += '}';
+			}
+
+			void Array(unsigned int depth, unsigned int width)
+			{
+				out += "[ ";
+				for (unsigned int i = 0; i < width; i++)
+				{
+					Value(0, depth);
+					out += ' ';
+				}
+				out += ']';
+			}
+
+			void Global()
+			{
+				Name();
+				out += " = ";
+				switch (settings.shape)
+				{
+					case Shape::Literals:
+						if (random.Chance(50))
+							Struct(0, 1, settings.width);
+						else
+							Array(1, settings.width);
+						break;
+					case Shape::Strings:
+						String();
+						break;
+					default:
+						if (random.Chance(60))
+							Struct(0, 1, 1 + (unsigned int)random.Below(settings.width));
+						else
+							Value(0, 0);
+						break;
+				}
+				out += "\n\n";
+			}
+
+			void Call(unsigned int level)
+			{
+				Indent(level);
+				Name();
+				unsigned int args = (unsigned int)random.Below(3);
+				for (unsigned int i = 0; i < args; i++)
+				{
+					out += ' ';
+					Name();
+					out += " = ";
+					if (random.Chance(30))
+					{
+						out += "(<x> + ";
+						Integer();
+						out += ") * 2";
+					}
+					else
+					{
+						Value(level, settings.depth);
+					}
+				}
+				out += '\n';
+			}
+
+			void Block(unsigned int level, unsigned int depth)
+			{
+				// The large shape fills outer blocks past the reach of short jumps
+				if (settings.shape == Shape::Large && depth <= 2 && random.Chance(50))
+				{
+					size_t block_end = out.size() + min_large_block_size + random.Below(min_large_block_size);
+					while (out.size() < block_end && Budget())
+						Statement(level, depth);
+					return;
+				}
+
+				unsigned int count = 1 + (unsigned int)random.Below(3);
+				for (unsigned int i = 0; i < count && Budget(); i++)
+					Statement(level, depth);
+			}
+
+			void Statement(unsigned int level, unsigned int depth)
+			{
+				statements--;
+
+				// Nesting goes as deep as allowed, the other shapes stay shallow
+				unsigned int nest = (settings.shape == Shape::Nesting) ? 90 : 25;
+				unsigned int randoms = (settings.shape == Shape::Random) ? 60 : 8;
+				if (depth >= settings.depth || !Budget() || !random.Chance(nest + randoms))
+				{
+					if (random.Chance(5))
+					{
+						Indent(level);
+						out += "RETURN\n";
+					}
+					else
+					{
+						Call(level);
+					}
+					return;
+				}
+
+				if (random.Below(nest + randoms) >= nest)
+				{
+					// RANDOM, cases are on their own lines
+					// Long weight lists are only put outside of blocks, where their size doesn't matter
+					// There are always at least two cases, since a lone case has no jump to RANDOMEND and the
+					// decompiler can't tell where it was, so the script wouldn't come back the same from a round trip
+					static const char *keywords[] = { "RANDOM", "RANDOM2", "RANDOM_NO_REPEAT", "RANDOM_PERMUTE" };
+					unsigned int weights = 2 + (unsigned int)random.Below(3);
+					if (settings.shape == Shape::Random)
+						weights = std::max((depth == 0) ? settings.width : std::min(settings.width, 8u), 2u);
+
+					Indent(level);
+					out += keywords[random.Below(4)];
+					out += '(';
+					for (unsigned int i = 0; i < weights; i++)
+					{
+						if (i != 0)
+							out += ", ";
+						out += std::to_string(1 + random.Below(100));
+					}
+					out += ")\n";
+					for (unsigned int i = 0; i < weights; i++)
+					{
+						Indent(level + 1);
+						out += "RANDOMCASE\n";
+						if (Budget() && random.Chance(30))
+							Statement(level + 2, depth + 1);
+						else
+							Call(level + 2);
+					}
+					Indent(level);
+					out += "RANDOMEND\n";
+					return;
+				}
+
+				switch (random.Below(3))
+				{
+					case 0:
+					case 1:
+					{
+						// IF, with or without an ELSE
+						Indent(level);
+						if (random.Chance(50))
+						{
+							out += "IF GotParam ";
+							Name();
+						}
+						else
+						{
+							out += "IF (<x> = ";
+							Integer();
+							out += ')';
+						}
+						out += '\n';
+						Block(level + 1, depth + 1);
+						if (random.Chance(50))
+						{
+							Indent(level);
+							out += "ELSE\n";
+							Block(level + 1, depth + 1);
+						}
+						Indent(level);
+						out += "ENDIF\n";
+						break;
+					}
+					case 2:
+					{
+						// SWITCH
+						Indent(level);
+						out += "SWITCH <x>\n";
+						unsigned int cases = 1 + (unsigned int)random.Below(4);
+						for (unsigned int i = 0; i < cases; i++)
+						{
+							Indent(level);
+							out += "CASE " + std::to_string(i) + "\n";
+							Block(level + 1, depth + 1);
+						}
+						if (random.Chance(50))
+						{
+							Indent(level);
+							out += "DEFAULT\n";
+							Block(level + 1, depth + 1);
+						}
+						Indent(level);
+						out += "ENDSWITCH\n";
+						break;
+					}
+				}
+			}
+
+			void Script()
+			{
+				out += "SCRIPT ";
+				Name();
+				out += " x = ";
+				Integer();
+				out += '\n';
+
+				in_script = true;
+				script_start = out.size();
+				statements = (settings.shape == Shape::Large) ? (size_t)-1 : 1 + random.Below(max_statements);
+				while (Budget())
+					Statement(1, 0);
+				in_script = false;
+
+				out += "ENDSCRIPT\n\n";
+			}
+
+		public:
+			Generator(const Settings &_settings) : settings(_settings), random(_settings.seed)
+			{
+				// Names written out as they are
+				for (const char *fixed : { "GotParam", "x" })
+					checksums.emplace((uint32_t)QScript::CRC(fixed), (uint64_t)-1);
+			}
+
+			// Writes definitions until the size is reached
+			size_t Write(std::ostream &stream)
+			{
+				size_t written = 0;
+				unsigned int globals = (settings.shape == Shape::Literals || settings.shape == Shape::Strings) ? 70 : 30;
+				while (written < settings.size)
+				{
+					out.clear();
+					if (random.Chance(globals))
+						Global();
+					else
+						Script();
+
+					stream.write(out.data(), out.size());
+					written += out.size();
+				}
+				return written;
+			}
+	};
+}
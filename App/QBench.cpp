@@ -0,0 +1,337 @@
+#include <QScript/QCompile.h>
+#include <QScript/QDecompile.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "QBinary.h"
+#include "QLexer.h"
+#include "QUtil.h"
+
+#include "ArgsParse.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define QBENCH_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define QBENCH_TSC
+#endif
+
+namespace Bench
+{
+	// Results are added here so the work being measured can't be optimized out
+	static volatile size_t sink = 0;
+
+	static void Keep(size_t value)
+	{
+		sink = sink + value;
+	}
+
+	struct Result
+	{
+		std::string name;
+		size_t iterations = 0; // Per sample
+		size_t samples = 0;
+		double ns_min = 0.0, ns_median = 0.0; // Per iteration
+		double cycles_min = 0.0; // Per iteration, 0 when there's no cycle counter
+		size_t bytes = 0, items = 0; // Processed per iteration
+	};
+
+	struct Settings
+	{
+		double min_sample_ns = 50e6;
+		size_t samples = 7;
+	};
+
+	static uint64_t Cycles()
+	{
+	#ifdef QBENCH_TSC
+		return __rdtsc();
+	#else
+		return 0;
+	#endif
+	}
+
+	// Runs a function enough times to fill each sample, keeping the fastest and median time per iteration
+	template <typename F>
+	Result Run(const Settings &settings, const std::string &name, size_t bytes, size_t items, F &&func)
+	{
+		using Clock = std::chrono::steady_clock;
+		std::cerr << name << "..." << std::flush;
+
+		// Warm up and find how many iterations fill a sample
+		func();
+		size_t iterations = 1;
+		while (1)
+		{
+			auto start = Clock::now();
+			for (size_t i = 0; i < iterations; i++)
+				func();
+			double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			if (ns >= settings.min_sample_ns)
+				break;
+			iterations *= 2;
+		}
+
+		// Slow runs get fewer samples
+		size_t samples = settings.samples;
+		if (iterations == 1)
+			samples = std::min<size_t>(samples, 3);
+
+		std::vector<double> times;
+		std::vector<double> cycles;
+		for (size_t s = 0; s < samples; s++)
+		{
+			uint64_t start_cycles = Cycles();
+			auto start = Clock::now();
+			for (size_t i = 0; i < iterations; i++)
+				func();
+			double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+			uint64_t end_cycles = Cycles();
+
+			times.push_back(ns / iterations);
+			cycles.push_back((double)(end_cycles - start_cycles) / iterations);
+		}
+		std::sort(times.begin(), times.end());
+
+		Result result;
+		result.name = name;
+		result.iterations = iterations;
+		result.samples = samples;
+		result.ns_min = times.front();
+		result.ns_median = times[times.size() / 2];
+		result.cycles_min = *std::min_element(cycles.begin(), cycles.end());
+		result.bytes = bytes;
+		result.items = items;
+
+		std::cerr << " " << result.ns_min / 1e6 << " ms" << std::endl;
+		return result;
+	}
+
+	// Makes a script of about the given size out of globals and scripts with distinct names
+	static std::string MakeSource(size_t size)
+	{
+		std::string source;
+		for (size_t i = 0; source.size() < size; i++)
+		{
+			std::string n = std::to_string(i);
+			if (i % 3 == 0)
+			{
+				source += "glob_" + n + " = { a = " + n + " b = \"s" + n + "\\n\" c = [ 1 2 " + n + " ] v = VECTOR(1, 2.5, " + n + ") p = PAIR(0.5, 1) }\n\n";
+				continue;
+			}
+			source +=
+				"SCRIPT scr_" + n + " x = " + n + "\n"
+				"\tIF GotParam p_" + n + "\n"
+				"\t\tprintf \"a " + n + "\"\n"
+				"\tELSE\n"
+				"\t\tSWITCH <x>\n"
+				"\t\tCASE 1\n"
+				"\t\t\tRETURN\n"
+				"\t\tDEFAULT\n"
+				"\t\t\tfoo_" + n + " value = (<x> + 1) * 2\n"
+				"\t\tENDSWITCH\n"
+				"\tENDIF\n"
+				"\tRANDOM(1, 2, 3) RANDOMCASE a_" + n + " RANDOMCASE b RANDOMCASE c RANDOMEND\n"
+				"ENDSCRIPT\n\n";
+		}
+		return source;
+	}
+
+	static void WriteJson(std::ostream &out, const std::vector<Result> &results)
+	{
+		out << "{\n";
+		out << "\t\"build\": \"" <<
+		#ifdef NDEBUG
+			"release"
+		#else
+			"debug"
+		#endif
+			<< "\",\n";
+		out << "\t\"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+		out << "\t\"benchmarks\": [\n";
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const auto &result = results[i];
+			double seconds = result.ns_min / 1e9;
+			out << "\t\t{ ";
+			out << "\"name\": \"" << result.name << "\", ";
+			out << "\"iterations\": " << result.iterations << ", ";
+			out << "\"samples\": " << result.samples << ", ";
+			out << "\"ns_min\": " << result.ns_min << ", ";
+			out << "\"ns_median\": " << result.ns_median << ", ";
+			out << "\"bytes\": " << result.bytes << ", ";
+			out << "\"items\": " << result.items << ", ";
+			out << "\"mb_per_s\": " << (result.bytes / 1e6) / seconds << ", ";
+			if (result.items != 0)
+				out << "\"items_per_s\": " << result.items / seconds << ", ";
+			else
+				out << "\"items_per_s\": null, ";
+			if (result.cycles_min > 0.0)
+				out << "\"bytes_per_cycle\": " << result.bytes / result.cycles_min;
+			else
+				out << "\"bytes_per_cycle\": null";
+			out << " }" << (i + 1 < results.size() ? "," : "") << "\n";
+		}
+		out << "\t]\n";
+		out << "}\n";
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments, running with none uses the defaults
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "output", { "Output results, written to stdout if not given", "", "json", {}, false}},
+		{ "quick", { "Shorter samples and a smaller huge input", "", "", {}, false}},
+	};
+	std::unordered_map<std::string, std::string> args;
+	if (argc > 1)
+	{
+		args = ArgsParse::Parse(argc, argv, args_def);
+		if (args.empty())
+			return 0;
+	}
+	bool quick = args.find("quick") != args.end();
+
+	Bench::Settings settings;
+	if (quick)
+	{
+		settings.min_sample_ns = 10e6;
+		settings.samples = 3;
+	}
+
+	try
+	{
+		std::vector<Bench::Result> results;
+
+		// Inputs
+		std::string source_small = Bench::MakeSource(2 * 1024);
+		std::string source_medium = Bench::MakeSource(256 * 1024);
+		std::string source_huge = Bench::MakeSource(quick ? 4 * 1024 * 1024 : 16 * 1024 * 1024);
+
+		std::vector<unsigned char> binary = QScript::Compile(source_medium, QScript::Target::THUG2);
+		char *p_start = (char *)binary.data();
+		char *p_end = p_start + binary.size();
+
+		// CRC
+		{
+			std::vector<std::string> names;
+			size_t bytes = 0;
+			for (size_t i = 0; i < 4096; i++)
+			{
+				names.push_back("Some_Script_Name_" + std::to_string(i));
+				bytes += names.back().size();
+			}
+			results.push_back(Bench::Run(settings, "crc", bytes, names.size(), [&]()
+				{
+					for (const auto &name : names)
+						Bench::Keep(QScript::CRC(name.c_str()));
+				}));
+		}
+
+		// Lexer
+		{
+			QScript::LexerState state;
+			QScript::Lex(source_medium, state);
+			size_t tokens = state.tokens.size();
+			results.push_back(Bench::Run(settings, "lex", source_medium.size(), tokens, [&]()
+				{
+					QScript::Lex(source_medium, state);
+					Bench::Keep(state.tokens.size());
+				}));
+		}
+
+		// Compile
+		{
+			QScript::LexerState state;
+			QScript::Lex(source_medium, state);
+			size_t tokens = state.tokens.size();
+
+			QScript::Compiler compiler;
+			QScript::CompileResult result;
+			results.push_back(Bench::Run(settings, "compile", source_medium.size(), tokens, [&]()
+				{
+					compiler.Compile(source_medium, QScript::Target::THUG2, QScript::CompileOptions(), result);
+					Bench::Keep(result.bytecode.size());
+				}));
+		}
+
+		// SkipToken
+		size_t binary_tokens = 0;
+		for (char *p = p_start; p != nullptr; p = QScript::SkipToken(p_start, p_end, p))
+			binary_tokens++;
+		{
+			results.push_back(Bench::Run(settings, "skip_token", binary.size(), binary_tokens, [&]()
+				{
+					for (char *p = p_start; p != nullptr; p = QScript::SkipToken(p_start, p_end, p))
+						Bench::Keep(1);
+				}));
+		}
+
+		// GetLabels
+		{
+			std::vector<std::pair<ptrdiff_t, std::string_view>> labels;
+			QScript::GetLabels(p_start, p_end, p_start, labels);
+			results.push_back(Bench::Run(settings, "get_labels", binary.size(), labels.size(), [&]()
+				{
+					QScript::GetLabels(p_start, p_end, p_start, labels);
+					Bench::Keep(labels.size());
+				}));
+		}
+
+		// Decompile
+		{
+			QScript::Decompiler decompiler;
+			results.push_back(Bench::Run(settings, "decompile", binary.size(), binary_tokens, [&]()
+				{
+					Bench::Keep(decompiler.Decompile(std::span<const std::byte>((const std::byte *)binary.data(), binary.size())).size());
+				}));
+		}
+
+		// End to end, without sessions so every buffer is made from scratch
+		for (const auto &input : { std::make_pair("small", &source_small), std::make_pair("medium", &source_medium), std::make_pair("huge", &source_huge) })
+		{
+			const std::string &source = *input.second;
+			std::vector<unsigned char> bytecode = QScript::Compile(source, QScript::Target::THUG2);
+
+			results.push_back(Bench::Run(settings, std::string("e2e_compile_") + input.first, source.size(), 0, [&]()
+				{
+					Bench::Keep(QScript::Compile(source, QScript::Target::THUG2).size());
+				}));
+			results.push_back(Bench::Run(settings, std::string("e2e_decompile_") + input.first, bytecode.size(), 0, [&]()
+				{
+					Bench::Keep(QScript::Decompile(std::span<const std::byte>((const std::byte *)bytecode.data(), bytecode.size())).size());
+				}));
+		}
+
+		// Write out results
+		if (args.find("output") != args.end())
+		{
+			std::ofstream out_file(args["output"]);
+			if (!out_file.is_open())
+			{
+				std::cerr << "Failed to open output file" << std::endl;
+				return 1;
+			}
+			Bench::WriteJson(out_file, results);
+		}
+		else
+		{
+			Bench::WriteJson(std::cout, results);
+		}
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << "QScript benchmark failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,518 @@
+#include <QScript/QSymbols.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "QBinary.h"
+#include "QUtil.h"
+
+#include "ArgsParse.h"
+#include "Tools.h"
+
+namespace Buckets
+{
+	// A name that would be put in the engine's symbol tables
+	struct Entry
+	{
+		uint32_t checksum = 0;
+		std::string name; // Hex checksum if no name was found
+		size_t uses = 0; // Name tokens referring to it across the binaries
+	};
+
+	struct FileNames
+	{
+		std::string problem; // Empty if the binary was read
+		std::vector<std::pair<uint32_t, std::string>> names; // From the checksum table
+		std::unordered_map<uint32_t, size_t> uses;
+	};
+
+	struct Worker
+	{
+		std::vector<char> data;
+		std::vector<std::pair<uint32_t, std::string_view>> checksum_strings;
+	};
+
+	static void Collect(const std::filesystem::path &path, FileNames &file, Worker &worker)
+	{
+		// Read in file
+		{
+			std::ifstream stream(path, std::ios::binary | std::ios::ate);
+			if (!stream.is_open())
+			{
+				file.problem = "Failed to open file";
+				return;
+			}
+
+			size_t size = stream.tellg();
+			worker.data.resize(size);
+
+			stream.seekg(0, std::ios::beg);
+			stream.read(worker.data.data(), size);
+		}
+		char *p_start = worker.data.data();
+		char *p_end = p_start + worker.data.size();
+
+		QScript::Error error;
+		if (!QScript::CheckBinary(p_start, p_end, error))
+		{
+			file.problem = error.Message();
+			return;
+		}
+
+		QScript::GetChecksumStrings(p_start, p_end, p_start, worker.checksum_strings);
+		for (const auto &checksum_string : worker.checksum_strings)
+			file.names.emplace_back(checksum_string.first, std::string(checksum_string.second));
+
+		for (char *p_token = p_start; p_token != nullptr; p_token = QScript::SkipToken(p_start, p_end, p_token))
+		{
+			if ((QScript::Token)*p_token == QScript::Token::Name)
+				file.uses[QScript::GetUnsignedInteger(p_start, p_end, p_token + 1)]++;
+		}
+	}
+
+	// Bucket index functions, the table size is a power of two for all but modulo
+	enum class Index
+	{
+		Low,
+		High,
+		Modulo,
+		Fold,
+		Fibonacci,
+	};
+
+	struct IndexDef
+	{
+		const char *name;
+		Index index;
+	};
+
+	static const IndexDef index_defs[] = {
+		{ "low", Index::Low },
+		{ "high", Index::High },
+		{ "modulo", Index::Modulo },
+		{ "fold", Index::Fold },
+		{ "fibonacci", Index::Fibonacci },
+	};
+
+	static unsigned int Bits(size_t size)
+	{
+		unsigned int bits = 0;
+		while (((size_t)1 << bits) < size)
+			bits++;
+		return bits;
+	}
+
+	static size_t Bucket(Index index, uint32_t checksum, size_t size, unsigned int bits)
+	{
+		switch (index)
+		{
+			case Index::Low:
+				return checksum & (size - 1);
+			case Index::High:
+				return bits != 0 ? checksum >> (32 - bits) : 0;
+			case Index::Modulo:
+				return checksum % size;
+			case Index::Fold:
+			{
+				// Xor of every bits wide slice of the checksum
+				if (bits == 0)
+					return 0;
+				uint32_t fold = 0;
+				for (unsigned int shift = 0; shift < 32; shift += bits)
+					fold ^= checksum >> shift;
+				return fold & (size - 1);
+			}
+			case Index::Fibonacci:
+				return bits != 0 ? (uint32_t)(checksum * 2654435769u) >> (32 - bits) : 0;
+		}
+		return 0;
+	}
+
+	// Distribution of the entries over one table
+	struct Simulation
+	{
+		const char *index;
+		size_t size = 0;
+
+		size_t used = 0; // Buckets with at least one entry
+		size_t longest = 0;
+		double probes = 0.0; // Average entries compared for a lookup of a present name
+		double uniform_probes = 0.0; // The same for an ideal spread
+		double weighted_probes = 0.0; // Weighted by each name's uses, if any were counted
+
+		std::vector<size_t> chain_lengths; // Count of buckets by chain length
+		std::vector<std::pair<size_t, std::vector<const Entry*>>> worst; // Longest chains, by bucket
+	};
+
+	static void Simulate(Simulation &simulation, Index index, const std::vector<Entry> &entries, size_t top)
+	{
+		size_t size = simulation.size;
+		unsigned int bits = Bits(size);
+
+		std::vector<size_t> buckets(entries.size());
+		std::vector<size_t> lengths(size);
+		for (size_t i = 0; i < entries.size(); i++)
+			lengths[buckets[i] = Bucket(index, entries[i].checksum, size, bits)]++;
+
+		// A name is found after comparing itself and everything before it in its chain, so a chain of n costs n(n+1)/2 altogether
+		double total_probes = 0.0;
+		for (size_t length : lengths)
+		{
+			if (length == 0)
+				continue;
+			simulation.used++;
+			simulation.longest = std::max(simulation.longest, length);
+			total_probes += (double)length * (length + 1) / 2.0;
+		}
+		if (!entries.empty())
+		{
+			simulation.probes = total_probes / entries.size();
+			simulation.uniform_probes = 1.0 + (double)(entries.size() - 1) / (2.0 * size);
+		}
+
+		simulation.chain_lengths.resize(simulation.longest + 1);
+		for (size_t length : lengths)
+			simulation.chain_lengths[length]++;
+
+		// Weight by uses, taking the average position in the chain as the cost for each name
+		size_t total_uses = 0;
+		double weighted = 0.0;
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			total_uses += entries[i].uses;
+			weighted += entries[i].uses * (lengths[buckets[i]] + 1) / 2.0;
+		}
+		if (total_uses != 0)
+			simulation.weighted_probes = weighted / total_uses;
+
+		// Longest chains, ties going to the lower bucket
+		std::vector<size_t> order;
+		for (size_t i = 0; i < size; i++)
+		{
+			if (lengths[i] > 1)
+				order.push_back(i);
+		}
+		size_t count = (top != 0) ? std::min(top, order.size()) : order.size();
+		std::partial_sort(order.begin(), order.begin() + count, order.end(), [&lengths](size_t a, size_t b) { return lengths[a] != lengths[b] ? lengths[a] > lengths[b] : a < b; });
+		order.resize(count);
+
+		std::unordered_map<size_t, size_t> worst_index;
+		for (size_t bucket : order)
+		{
+			worst_index[bucket] = simulation.worst.size();
+			simulation.worst.emplace_back(bucket, std::vector<const Entry*>());
+		}
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			auto find = worst_index.find(buckets[i]);
+			if (find != worst_index.end())
+				simulation.worst[find->second].second.push_back(&entries[i]);
+		}
+
+		// Hottest names first, those are the ones worth renaming
+		for (auto &chain : simulation.worst)
+			std::stable_sort(chain.second.begin(), chain.second.end(), [](const Entry *a, const Entry *b) { return a->uses > b->uses; });
+	}
+
+	static bool SplitList(const std::string &list, std::vector<std::string> &items)
+	{
+		std::stringstream stream(list);
+		std::string item;
+		while (std::getline(stream, item, ','))
+		{
+			if (item.empty())
+				return false;
+			items.push_back(item);
+		}
+		return !items.empty();
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "input", { "Input binary, or a directory to take the names of every binary under", "", "qb", {}, false}},
+		{ "dictionary", { "Shared symbol dictionary, its names are added to the tables and name the binaries' checksums", "", "qbsym", {}, false}},
+		{ "names", { "Extra names to add to the tables, one per line, such as candidate renames", "", "txt", {}, false}},
+		{ "sizes", { "Table sizes to simulate, separated by commas", "256,1024,4096", "", {}, false, "sizes"}},
+		{ "index", { "Bucket index functions to simulate, separated by commas, or all: "
+			"low (low bits of the checksum), high (high bits), modulo (checksum modulo the size), "
+			"fold (xor of every slice of the checksum), fibonacci (high bits of the checksum times 2^32/phi)", "low", "", {}, false, "functions"}},
+		{ "top", { "Worst chains to list for each table, 0 lists every chain with a collision", "10", "", {}, false, "count"}},
+		{ "format", { "Output format", "text", "", { { "text", "Readable report" }, { "json", "JSON object" } }, false}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	if (args.find("input") == args.end() && args.find("dictionary") == args.end() && args.find("names") == args.end())
+	{
+		std::cerr << "No names given, pass an input, dictionary or names file" << std::endl;
+		return 1;
+	}
+
+	size_t top;
+	try
+	{
+		top = std::stoull(args["top"]);
+	}
+	catch (const std::exception &)
+	{
+		std::cerr << "Invalid top count" << std::endl;
+		return 1;
+	}
+
+	// Table sizes
+	std::vector<std::string> items;
+	std::vector<size_t> sizes;
+	if (!Buckets::SplitList(args["sizes"], items))
+	{
+		std::cerr << "Invalid table sizes" << std::endl;
+		return 1;
+	}
+	for (const auto &item : items)
+	{
+		size_t size = 0, end = 0;
+		try
+		{
+			size = std::stoull(item, &end, 0);
+		}
+		catch (const std::exception &)
+		{
+			end = 0;
+		}
+		if (end != item.size() || size == 0 || size > ((size_t)1 << 31))
+		{
+			std::cerr << "Invalid table size: " << item << std::endl;
+			return 1;
+		}
+		sizes.push_back(size);
+	}
+
+	// Index functions
+	items.clear();
+	std::vector<const Buckets::IndexDef*> indices;
+	if (args["index"] == "all")
+	{
+		for (const auto &index_def : Buckets::index_defs)
+			indices.push_back(&index_def);
+	}
+	else
+	{
+		if (!Buckets::SplitList(args["index"], items))
+		{
+			std::cerr << "Invalid index functions" << std::endl;
+			return 1;
+		}
+		for (const auto &item : items)
+		{
+			auto it = std::find_if(std::begin(Buckets::index_defs), std::end(Buckets::index_defs), [&item](const Buckets::IndexDef &index_def) { return item == index_def.name; });
+			if (it == std::end(Buckets::index_defs))
+			{
+				std::cerr << "Unknown index function: " << item << std::endl;
+				return 1;
+			}
+			indices.push_back(&*it);
+		}
+	}
+
+	// Masking and shifting only spread over the whole table if it's a power of two
+	for (const auto *index_def : indices)
+	{
+		if (index_def->index == Buckets::Index::Modulo)
+			continue;
+		for (size_t size : sizes)
+		{
+			if ((size & (size - 1)) != 0)
+			{
+				std::cerr << "Table size " << size << " isn't a power of two, which " << index_def->name << " needs" << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	// Read in dictionary
+	QScript::Symbols dictionary;
+	if (args.find("dictionary") != args.end() && !Tools::ReadSymbolsFile(args["dictionary"], dictionary))
+		return 1;
+
+	// Collect binaries
+	std::vector<std::filesystem::path> inputs;
+	if (args.find("input") != args.end() && !Tools::CollectBinaries(args["input"], inputs))
+		return 1;
+
+	// Take names on a pool of threads, each with its own read buffer
+	std::vector<Buckets::FileNames> files(inputs.size());
+
+	Tools::RunPool<Buckets::Worker>(inputs.size(), [&](size_t i, Buckets::Worker &worker)
+		{
+			try
+			{
+				Buckets::Collect(inputs[i], files[i], worker);
+			}
+			catch (const std::exception &e)
+			{
+				files[i].problem = e.what();
+			}
+		});
+
+	// Merge names, the first name found for a checksum wins
+	size_t failed = 0;
+	std::unordered_map<uint32_t, Buckets::Entry> merged;
+	auto add = [&merged](uint32_t checksum, const std::string &name, size_t uses)
+		{
+			auto &entry = merged[checksum];
+			entry.checksum = checksum;
+			if (entry.name.empty())
+				entry.name = name;
+			entry.uses += uses;
+		};
+
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		const auto &file = files[i];
+		if (!file.problem.empty())
+		{
+			std::cerr << inputs[i].string() << ": " << file.problem << std::endl;
+			failed++;
+			continue;
+		}
+		for (const auto &name : file.names)
+			add(name.first, name.second, 0);
+		for (const auto &use : file.uses)
+			add(use.first, std::string(), use.second);
+	}
+	for (const auto &symbol : dictionary)
+		add(symbol.first, symbol.second, 0);
+
+	if (args.find("names") != args.end())
+	{
+		std::ifstream names_file(args["names"]);
+		if (!names_file.is_open())
+		{
+			std::cerr << "Failed to open names file" << std::endl;
+			return 1;
+		}
+		std::string name;
+		while (std::getline(names_file, name))
+		{
+			if (!name.empty() && name.back() == '\r')
+				name.pop_back();
+			if (!name.empty())
+				add((uint32_t)QScript::CRC(name.c_str()), name, 0);
+		}
+	}
+
+	std::vector<Buckets::Entry> entries;
+	entries.reserve(merged.size());
+	for (auto &entry : merged)
+	{
+		if (entry.second.name.empty())
+		{
+			char hex[16];
+			std::snprintf(hex, sizeof(hex), "0x%08X", entry.second.checksum);
+			entry.second.name = hex;
+		}
+		entries.push_back(std::move(entry.second));
+	}
+	std::sort(entries.begin(), entries.end(), [](const Buckets::Entry &a, const Buckets::Entry &b) { return a.checksum < b.checksum; });
+
+	// Simulate every table
+	std::vector<Buckets::Simulation> simulations;
+	for (const auto *index_def : indices)
+	{
+		for (size_t size : sizes)
+		{
+			auto &simulation = simulations.emplace_back();
+			simulation.index = index_def->name;
+			simulation.size = size;
+			Buckets::Simulate(simulation, index_def->index, entries, top);
+		}
+	}
+
+	// Write out report
+	std::ostream &out = std::cout;
+	if (args["format"] == "json")
+	{
+		out << "{\n";
+		out << "\t\"files\": " << inputs.size() - failed << ",\n";
+		out << "\t\"failed\": " << failed << ",\n";
+		out << "\t\"names\": " << entries.size() << ",\n";
+		out << "\t\"tables\": [\n";
+		for (size_t i = 0; i < simulations.size(); i++)
+		{
+			const auto &simulation = simulations[i];
+			out << "\t\t{\n";
+			out << "\t\t\t\"index\": \"" << simulation.index << "\",\n";
+			out << "\t\t\t\"size\": " << simulation.size << ",\n";
+			out << "\t\t\t\"used\": " << simulation.used << ",\n";
+			out << "\t\t\t\"longest\": " << simulation.longest << ",\n";
+			out << "\t\t\t\"probes\": " << simulation.probes << ",\n";
+			out << "\t\t\t\"uniform_probes\": " << simulation.uniform_probes << ",\n";
+			out << "\t\t\t\"weighted_probes\": " << simulation.weighted_probes << ",\n";
+			out << "\t\t\t\"chain_lengths\": [";
+			for (size_t j = 0; j < simulation.chain_lengths.size(); j++)
+				out << (j == 0 ? " " : ", ") << simulation.chain_lengths[j];
+			out << (simulation.chain_lengths.empty() ? "],\n" : " ],\n");
+			out << "\t\t\t\"worst\": [\n";
+			for (size_t j = 0; j < simulation.worst.size(); j++)
+			{
+				const auto &chain = simulation.worst[j];
+				out << "\t\t\t\t{ \"bucket\": " << chain.first << ", \"names\": [";
+				for (size_t k = 0; k < chain.second.size(); k++)
+				{
+					out << (k == 0 ? " " : ", ") << "{ \"name\": ";
+					Tools::WriteJsonString(out, chain.second[k]->name);
+					out << ", \"checksum\": " << chain.second[k]->checksum << ", \"uses\": " << chain.second[k]->uses << " }";
+				}
+				out << " ] }" << (j + 1 < simulation.worst.size() ? "," : "") << "\n";
+			}
+			out << "\t\t\t]\n";
+			out << "\t\t}" << (i + 1 < simulations.size() ? "," : "") << "\n";
+		}
+		out << "\t]\n";
+		out << "}\n";
+	}
+	else
+	{
+		out << entries.size() << " names from " << inputs.size() - failed << " binaries" << (dictionary.empty() ? "" : " and the dictionary") << std::endl;
+		for (const auto &simulation : simulations)
+		{
+			out << std::endl << simulation.index << ", " << simulation.size << " buckets:" << std::endl;
+			out << "  " << simulation.used << " buckets used, longest chain " << simulation.longest << std::endl;
+			out << "  " << simulation.probes << " average probes, " << simulation.uniform_probes << " for an even spread";
+			if (simulation.weighted_probes != 0.0)
+				out << ", " << simulation.weighted_probes << " weighted by uses";
+			out << std::endl;
+
+			out << "  chains:";
+			for (size_t length = 1; length < simulation.chain_lengths.size(); length++)
+			{
+				if (simulation.chain_lengths[length] != 0)
+					out << " " << simulation.chain_lengths[length] << "x" << length;
+			}
+			out << std::endl;
+
+			for (const auto &chain : simulation.worst)
+			{
+				out << "  bucket " << chain.first << " (" << chain.second.size() << "):";
+				for (const auto *entry : chain.second)
+				{
+					out << " " << entry->name;
+					if (entry->uses != 0)
+						out << " (" << entry->uses << " uses)";
+				}
+				out << std::endl;
+			}
+		}
+	}
+	return failed != 0;
+}
@@ -0,0 +1,107 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/un.h>
+
+#include "ArgsParse.h"
+#include "Daemon.h"
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "socket", { "Unix domain socket the daemon listens on", "", "sock", {}, true}},
+		{ "mode", { "Request", "", "", { { "compile", "Compile a script" }, { "decompile", "Decompile a binary" } }, true}},
+		{ "input", { "Input script or binary", "", "q", {}, true}},
+		{ "output", { "Output binary or script", "", "qb", {}, true}},
+		{ "target", { "Script target", "thug2", "", { { "thug1", "Tony Hawk's Underground" }, {"thug2", "Tony Hawk's Underground 2"} }, false}},
+		{ "optimize", { "Optimize branches", "", "", {}, false}},
+		{ "linenumbers", { "Write line numbers into the bytecode", "", "", {}, false}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	bool compile = args["mode"] == "compile";
+
+	// Read in file
+	std::ifstream file(args["input"], std::ios::binary);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open input file" << std::endl;
+		return 1;
+	}
+
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string input = buffer.str();
+
+	// Build request
+	std::vector<unsigned char> request;
+	if (compile)
+	{
+		uint8_t flags = 0;
+		if (args.find("optimize") != args.end())
+			flags |= Daemon::FLAG_OPTIMIZE;
+		if (args.find("linenumbers") != args.end())
+			flags |= Daemon::FLAG_LINE_NUMBERS;
+
+		// The input path names the daemon's compile cache
+		request.push_back((unsigned char)Daemon::Command::Compile);
+		request.push_back(args["target"] == "thug1" ? 0 : 1);
+		request.push_back(flags);
+		Daemon::PutInt(request, (uint32_t)args["input"].size());
+		request.insert(request.end(), args["input"].begin(), args["input"].end());
+	}
+	else
+	{
+		request.push_back((unsigned char)Daemon::Command::Decompile);
+	}
+	request.insert(request.end(), input.begin(), input.end());
+
+	// Connect to daemon
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (args["socket"].size() >= sizeof(address.sun_path))
+	{
+		std::cerr << "Socket path is too long" << std::endl;
+		return 1;
+	}
+	args["socket"].copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		std::cerr << "Failed to connect to " << args["socket"] << std::endl;
+		return 1;
+	}
+
+	// Send request and wait for response
+	std::vector<unsigned char> response;
+	if (!Daemon::SendMessage(fd, request) || !Daemon::ReceiveMessage(fd, response) || response.empty())
+	{
+		std::cerr << "Lost connection to daemon" << std::endl;
+		close(fd);
+		return 1;
+	}
+	close(fd);
+
+	if ((Daemon::Status)response[0] != Daemon::Status::Ok)
+	{
+		std::cerr << (compile ? "QScript compilation failed: " : "QScript decompilation failed: ") << std::string(response.begin() + 1, response.end()) << std::endl;
+		return 1;
+	}
+
+	// Write out file
+	std::ofstream outFile(args["output"], std::ios::binary);
+	if (!outFile.is_open())
+	{
+		std::cerr << "Failed to open output file" << std::endl;
+		return 1;
+	}
+	outFile.write((const char*)response.data() + 1, response.size() - 1);
+	return 0;
+}
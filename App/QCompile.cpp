@@ -6,6 +6,10 @@
 #include <sstream>
 
 #include "ArgsParse.h"
+#include "Stats.h"
+#include "Tools.h"
+#include "Trace.h"
+#include "Watch.h"
 
 int main(int argc, char *argv[])
 {
@@ -14,6 +18,15 @@ int main(int argc, char *argv[])
 		{ "input", { "Input script", "", "q", {}, true}},
 		{ "output", { "Output binary", "", "qb", {}, true}},
 		{ "target", { "Script target", "", "", { { "thug1", "Tony Hawk's Underground" }, {"thug2", "Tony Hawk's Underground 2"} }, true}},
+		{ "optimize", { "Optimize branches", "", "", {}, false}},
+		{ "symbols", { "Strip checksum names out to a symbol sidecar, or a directory of them in watch mode", "", "qbsym", {}, false}},
+		{ "dictionary", { "Shared symbol dictionary, names found in it are not written out", "", "qbsym", {}, false}},
+		{ "sourcemap", { "Bytecode offset to source line map, or a directory of them in watch mode", "", "qbmap", {}, false}},
+		{ "linenumbers", { "Write line numbers into the bytecode", "", "", {}, false}},
+		{ "parallel", { "Lex and compile on several threads", "", "", {}, false}},
+		{ "watch", { "Treat input and output as directories, recompiling scripts as they're saved", "", "", {}, false}},
+		{ "stats", { "Print time spent in each phase and counts of what was made to stderr, added up over each batch in watch mode", "", "", { { "text", "Readable summary" }, { "json", "JSON object" } }, false}},
+		{ "trace", { "Write a Chrome trace of the compile, needs a build with QSCRIPT_TRACE", "", "json", {}, false}},
 	};
 	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
 	if (args.empty())
@@ -21,19 +34,9 @@ int main(int argc, char *argv[])
 
 	try
 	{
-		std::vector<unsigned char> out;
+		QScript::CompileResult out;
+		QScript::Stats stats;
 		{
-			// Read in file
-			std::ifstream file(args["input"]);
-			if (!file.is_open())
-			{
-				std::cerr << "Failed to open input file" << std::endl;
-				return 1;
-			}
-
-			std::stringstream buffer;
-			buffer << file.rdbuf();
-
 			// Select target
 			QScript::Target target;
 			if (args["target"] == "thug1")
@@ -46,23 +49,120 @@ int main(int argc, char *argv[])
 				return 1;
 			}
 
+			// Select options
+			QScript::CompileOptions options;
+			options.optimize_branches = args.find("optimize") != args.end();
+			options.strip_checksum_names = args.find("symbols") != args.end();
+			options.source_map = args.find("sourcemap") != args.end();
+			options.source_name = args["input"];
+			options.line_numbers = args.find("linenumbers") != args.end();
+			options.parallel = args.find("parallel") != args.end();
+
+			// Read in dictionary
+			QScript::Symbols dictionary;
+			if (args.find("dictionary") != args.end())
+			{
+				if (!Tools::ReadSymbolsFile(args["dictionary"], dictionary))
+					return 1;
+				options.shared_symbols = &dictionary;
+			}
+
+			// Watch source tree, each compile fills in its own stats
+			if (args.find("watch") != args.end())
+			{
+				// Traces cover one compile, a watch never finishes to write one out
+				if (args.find("trace") != args.end())
+				{
+					std::cerr << "Tracing can't be used with watch mode" << std::endl;
+					return 1;
+				}
+
+				Watch::Settings settings;
+				settings.target = target;
+				settings.options = options;
+				if (args.find("stats") != args.end())
+					settings.stats = args["stats"];
+				if (args.find("symbols") != args.end())
+					settings.symbols_root = args["symbols"];
+				if (args.find("sourcemap") != args.end())
+					settings.source_map_root = args["sourcemap"];
+				return Watch::Run(args["input"], args["output"], settings);
+			}
+
+			if (args.find("stats") != args.end())
+				options.stats = &stats;
+
+			// Read in file
+			if (!Tracing::Start(args))
+				return 1;
+
+			std::stringstream buffer;
+			{
+				QSCRIPT_TRACE_SCOPE("ReadInput", args["input"]);
+				std::ifstream file(args["input"]);
+				if (!file.is_open())
+				{
+					std::cerr << "Failed to open input file" << std::endl;
+					return 1;
+				}
+				buffer << file.rdbuf();
+			}
+
 			// Compile
-			out = QScript::Compile(buffer.str(), target);
+			QScript::Compile(buffer.str(), target, options, out);
 		}
 
 		// Write out file
+		QSCRIPT_TRACE_SCOPE("WriteOutput", args["output"]);
 		std::ofstream outFile(args["output"], std::ios::binary);
 		if (!outFile.is_open())
 		{
 			std::cerr << "Failed to open output file" << std::endl;
 			return 1;
 		}
-		outFile.write((const char*)out.data(), out.size());
+		outFile.write((const char*)out.bytecode.data(), out.bytecode.size());
+
+		// Write out symbols
+		if (args.find("symbols") != args.end())
+		{
+			std::ofstream symbols_file(args["symbols"], std::ios::binary);
+			if (!symbols_file.is_open())
+			{
+				std::cerr << "Failed to open symbols file" << std::endl;
+				return 1;
+			}
+
+			std::vector<unsigned char> sidecar = QScript::WriteSymbols(out.symbols);
+			symbols_file.write((const char*)sidecar.data(), sidecar.size());
+		}
+
+		// Write out source map
+		if (args.find("sourcemap") != args.end())
+		{
+			std::ofstream source_map_file(args["sourcemap"], std::ios::binary);
+			if (!source_map_file.is_open())
+			{
+				std::cerr << "Failed to open source map file" << std::endl;
+				return 1;
+			}
+
+			std::vector<unsigned char> sidecar = QScript::WriteSourceMap(out.source_map);
+			source_map_file.write((const char*)sidecar.data(), sidecar.size());
+		}
+
+		// Print stats
+		if (args.find("stats") != args.end())
+			Stats::Write(std::cerr, stats, args["stats"]);
 	}
 	catch (const std::exception &e)
 	{
 		std::cerr << "QScript compilation failed: " << e.what() << std::endl;
+		Tracing::Stop(args);
 		return 1;
 	}
+
+	// Write out trace
+	if (!Tracing::Stop(args))
+		return 1;
 	return 0;
 }
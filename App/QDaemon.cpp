@@ -0,0 +1,287 @@
+#include <QScript/QCompile.h>
+#include <QScript/QDecompile.h>
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/un.h>
+
+#include "ArgsParse.h"
+#include "Daemon.h"
+#include "Tools.h"
+
+// Most connections served at once, more wait in the listen backlog
+static constexpr size_t MAX_CONNECTIONS = 64;
+
+// Most named compile caches kept, the least recently used is dropped past this
+static constexpr size_t MAX_CACHES = 256;
+
+// Time to wait before accepting again after accept fails, so running out of descriptors doesn't spin
+static constexpr std::chrono::milliseconds ACCEPT_BACKOFF(100);
+
+// Compiler and decompiler sessions, with their buffers
+struct Worker
+{
+	QScript::Compiler compiler;
+	QScript::Decompiler decompiler;
+	QScript::CompileResult compiled;
+	std::vector<unsigned char> response;
+};
+
+// Warm state shared by every connection
+struct DaemonState
+{
+	QScript::Symbols dictionary;
+
+	// Workers between connections, a connection takes one while it's served and hands it back after
+	// There are never more workers than connections served at once, and they stay warm between clients
+	std::mutex workers_mutex;
+	std::vector<std::unique_ptr<Worker>> idle_workers;
+
+	// Compile caches by name, each one is only used by one request at a time
+	// A request keeps its cache alive if it's dropped while in use
+	struct Cache
+	{
+		std::mutex mutex;
+		QScript::CompileCache cache;
+	};
+	struct CacheEntry
+	{
+		std::shared_ptr<Cache> cache;
+		std::list<std::string>::iterator use; // Position in cache_uses
+	};
+	std::mutex caches_mutex;
+	std::unordered_map<std::string, CacheEntry> caches;
+	std::list<std::string> cache_uses; // Most recently used first
+
+	// Connections being served
+	std::mutex connections_mutex;
+	std::condition_variable connections_done;
+	size_t connections = 0;
+};
+
+// Finds or creates a named cache, marking it as the most recently used
+static std::shared_ptr<DaemonState::Cache> GetCache(DaemonState &state, const std::string &name)
+{
+	std::lock_guard<std::mutex> lock(state.caches_mutex);
+
+	auto find = state.caches.find(name);
+	if (find != state.caches.end())
+	{
+		state.cache_uses.splice(state.cache_uses.begin(), state.cache_uses, find->second.use);
+		return find->second.cache;
+	}
+
+	// Drop the least recently used cache
+	if (state.caches.size() >= MAX_CACHES)
+	{
+		state.caches.erase(state.cache_uses.back());
+		state.cache_uses.pop_back();
+	}
+
+	state.cache_uses.push_front(name);
+	auto &entry = state.caches[name];
+	entry.cache = std::make_shared<DaemonState::Cache>();
+	entry.use = state.cache_uses.begin();
+	return entry.cache;
+}
+
+// Takes an idle worker, or makes one if they're all in use
+static std::unique_ptr<Worker> TakeWorker(DaemonState &state)
+{
+	{
+		std::lock_guard<std::mutex> lock(state.workers_mutex);
+		if (!state.idle_workers.empty())
+		{
+			std::unique_ptr<Worker> worker = std::move(state.idle_workers.back());
+			state.idle_workers.pop_back();
+			return worker;
+		}
+	}
+	return std::make_unique<Worker>();
+}
+
+static void ReturnWorker(DaemonState &state, std::unique_ptr<Worker> worker)
+{
+	std::lock_guard<std::mutex> lock(state.workers_mutex);
+	state.idle_workers.push_back(std::move(worker));
+}
+
+// Handles a request, leaving the response in the worker
+static void HandleRequest(DaemonState &state, Worker &worker, const std::vector<unsigned char> &request)
+{
+	std::vector<unsigned char> &response = worker.response;
+	response.clear();
+	response.push_back((unsigned char)Daemon::Status::Ok);
+
+	try
+	{
+		if (request.empty())
+			throw std::runtime_error("Empty request");
+
+		switch ((Daemon::Command)request[0])
+		{
+			case Daemon::Command::Compile:
+			{
+				// Read request
+				if (request.size() < 7)
+					throw std::runtime_error("Truncated compile request");
+
+				uint8_t target = request[1];
+				uint8_t flags = request[2];
+				uint32_t name_size = Daemon::GetInt(request.data() + 3);
+				if (target > (uint8_t)QScript::Target::THUG2)
+					throw std::runtime_error("Invalid target");
+				if (name_size > request.size() - 7)
+					throw std::runtime_error("Truncated compile request");
+
+				std::string name((const char*)request.data() + 7, name_size);
+				std::string source((const char*)request.data() + 7 + name_size, request.size() - 7 - name_size);
+
+				// Select options
+				QScript::CompileOptions options;
+				options.optimize_branches = (flags & Daemon::FLAG_OPTIMIZE) != 0;
+				options.line_numbers = (flags & Daemon::FLAG_LINE_NUMBERS) != 0;
+				options.source_name = name;
+				if (!state.dictionary.empty())
+					options.shared_symbols = &state.dictionary;
+
+				// Compile, with the named cache held for the duration
+				QScript::CompileResult &out = worker.compiled;
+				if (!name.empty())
+				{
+					std::shared_ptr<DaemonState::Cache> cache = GetCache(state, name);
+					std::lock_guard<std::mutex> lock(cache->mutex);
+					options.cache = &cache->cache;
+					worker.compiler.Compile(source, (QScript::Target)target, options, out);
+				}
+				else
+				{
+					worker.compiler.Compile(source, (QScript::Target)target, options, out);
+				}
+
+				response.insert(response.end(), out.bytecode.begin(), out.bytecode.end());
+				break;
+			}
+			case Daemon::Command::Decompile:
+			{
+				std::span<const std::byte> binary((const std::byte*)request.data() + 1, request.size() - 1);
+				std::string_view out = worker.decompiler.Decompile(binary, state.dictionary);
+				response.insert(response.end(), out.begin(), out.end());
+				break;
+			}
+			default:
+				throw std::runtime_error("Unknown command " + std::to_string((int)request[0]));
+		}
+	}
+	catch (const std::exception &e)
+	{
+		std::string message = e.what();
+		response.clear();
+		response.push_back((unsigned char)Daemon::Status::Error);
+		response.insert(response.end(), message.begin(), message.end());
+	}
+}
+
+static void HandleConnection(DaemonState &state, int fd)
+{
+	// Serve requests until the client hangs up
+	std::unique_ptr<Worker> worker = TakeWorker(state);
+	std::vector<unsigned char> request;
+	while (Daemon::ReceiveMessage(fd, request))
+	{
+		HandleRequest(state, *worker, request);
+		if (!Daemon::SendMessage(fd, worker->response))
+			break;
+	}
+	close(fd);
+	ReturnWorker(state, std::move(worker));
+
+	// Free up the connection for the next client
+	{
+		std::lock_guard<std::mutex> lock(state.connections_mutex);
+		state.connections--;
+	}
+	state.connections_done.notify_one();
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "socket", { "Unix domain socket to listen on", "", "sock", {}, true}},
+		{ "dictionary", { "Shared symbol dictionary, kept loaded for every request", "", "qbsym", {}, false}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	DaemonState state;
+
+	// Read in dictionary
+	if (args.find("dictionary") != args.end() && !Tools::ReadSymbolsFile(args["dictionary"], state.dictionary))
+		return 1;
+
+	// Listen on socket
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (args["socket"].size() >= sizeof(address.sun_path))
+	{
+		std::cerr << "Socket path is too long" << std::endl;
+		return 1;
+	}
+	args["socket"].copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd < 0)
+	{
+		std::cerr << "Failed to create socket" << std::endl;
+		return 1;
+	}
+
+	unlink(address.sun_path);
+	if (bind(listen_fd, (const sockaddr*)&address, sizeof(address)) != 0 || listen(listen_fd, 16) != 0)
+	{
+		std::cerr << "Failed to listen on " << args["socket"] << std::endl;
+		close(listen_fd);
+		return 1;
+	}
+
+	std::cout << "Listening on " << args["socket"] << std::endl;
+
+	// Serve connections concurrently, up to the limit
+	while (1)
+	{
+		{
+			std::unique_lock<std::mutex> lock(state.connections_mutex);
+			state.connections_done.wait(lock, [&]() { return state.connections < MAX_CONNECTIONS; });
+		}
+
+		int fd = accept(listen_fd, nullptr, nullptr);
+		if (fd < 0)
+		{
+			// Interrupted or the client gave up, anything else is likely to fail again straight away
+			if (errno != EINTR && errno != ECONNABORTED)
+				std::this_thread::sleep_for(ACCEPT_BACKOFF);
+			continue;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(state.connections_mutex);
+			state.connections++;
+		}
+		std::thread(HandleConnection, std::ref(state), fd).detach();
+	}
+	return 0;
+}
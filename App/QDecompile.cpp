@@ -2,9 +2,12 @@
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <vector>
 
 #include "ArgsParse.h"
+#include "Stats.h"
+#include "Trace.h"
 
 int main(int argc, char *argv[])
 {
@@ -12,34 +15,81 @@ int main(int argc, char *argv[])
 	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
 		{ "input", { "Input binary", "", "qb", {}, true}},
 		{ "output", { "Output script", "", "q", {}, true}},
+		{ "symbols", { "Symbol sidecar", "", "qbsym", {}, false}},
+		{ "dictionary", { "Shared symbol dictionary", "", "qbsym", {}, false}},
+		{ "stats", { "Print time spent in each phase and counts of what was read to stderr", "", "", { { "text", "Readable summary" }, { "json", "JSON object" } }, false}},
+		{ "trace", { "Write a Chrome trace of the decompile, needs a build with QSCRIPT_TRACE", "", "json", {}, false}},
 	};
 	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
 	if (args.empty())
 		return 0;
+	if (!Tracing::Start(args))
+		return 1;
 
 	try
 	{
 		std::string out;
 		{
-			// Read in file
-			std::ifstream file(args["input"], std::ios::binary | std::ios::ate);
-			if (!file.is_open())
+			// Read in symbols
+			QScript::Symbols symbols;
+			for (const char *arg : { "symbols", "dictionary" })
 			{
-				std::cerr << "Failed to open input file" << std::endl;
-				return 1;
+				if (args.find(arg) == args.end())
+					continue;
+
+				QSCRIPT_TRACE_SCOPE("ReadSymbols", args[arg]);
+				std::ifstream symbols_file(args[arg], std::ios::binary | std::ios::ate);
+				if (!symbols_file.is_open())
+				{
+					std::cerr << "Failed to open " << arg << " file" << std::endl;
+					return 1;
+				}
+
+				size_t size = symbols_file.tellg();
+				std::vector<char> data(size);
+
+				symbols_file.seekg(0, std::ios::beg);
+				symbols_file.read(data.data(), size);
+
+				QScript::Symbols read = QScript::ReadSymbols(data.data(), data.data() + data.size());
+				symbols.insert(read.begin(), read.end());
 			}
 
-			size_t size = file.tellg();
-			std::vector<char> data(size);
+			// Read in file
+			std::vector<char> data;
+			{
+				QSCRIPT_TRACE_SCOPE("ReadInput", args["input"]);
+				std::ifstream file(args["input"], std::ios::binary | std::ios::ate);
+				if (!file.is_open())
+				{
+					std::cerr << "Failed to open input file" << std::endl;
+					return 1;
+				}
+
+				size_t size = file.tellg();
+				data.resize(size);
 
-			file.seekg(0, std::ios::beg);
-			file.read(data.data(), size);
+				file.seekg(0, std::ios::beg);
+				file.read(data.data(), size);
+			}
 
 			// Decompile
-			out = QScript::Decompile(data.data(), data.data() + data.size());
+			if (args.find("stats") != args.end())
+			{
+				QScript::Stats stats;
+				std::stringstream stream;
+				QScript::Decompile(std::span<const std::byte>((const std::byte *)data.data(), data.size()), stream, symbols, stats);
+				out = stream.str();
+				Stats::Write(std::cerr, stats, args["stats"]);
+			}
+			else
+			{
+				out = QScript::Decompile(data.data(), data.data() + data.size(), symbols);
+			}
 		}
 
 		// Write out file
+		QSCRIPT_TRACE_SCOPE("WriteOutput", args["output"]);
 		std::ofstream outFile(args["output"]);
 		if (!outFile.is_open())
 		{
@@ -51,7 +101,12 @@ int main(int argc, char *argv[])
 	catch (const std::exception &e)
 	{
 		std::cerr << "QScript decompilation failed: " << e.what() << std::endl;
+		Tracing::Stop(args);
 		return 1;
 	}
+
+	// Write out trace
+	if (!Tracing::Stop(args))
+		return 1;
 	return 0;
 }
@@ -0,0 +1,109 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "ArgsParse.h"
+#include "Generate.h"
+
+// Reads a count, with an optional K, M or G suffix
+static bool ParseSize(const std::string &text, size_t &size)
+{
+	size_t end = 0;
+	unsigned long long value;
+	try
+	{
+		value = std::stoull(text, &end);
+	}
+	catch (const std::exception &)
+	{
+		return false;
+	}
+
+	std::string suffix = text.substr(end);
+	if (suffix == "K" || suffix == "k")
+		value *= 1024ull;
+	else if (suffix == "M" || suffix == "m")
+		value *= 1024ull * 1024;
+	else if (suffix == "G" || suffix == "g")
+		value *= 1024ull * 1024 * 1024;
+	else if (!suffix.empty())
+		return false;
+
+	size = (size_t)value;
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "output", { "Output script", "", "q", {}, true}},
+		{ "seed", { "Random seed, the same seed and settings always make the same script", "1", "", {}, false, "number"}},
+		{ "size", { "Size of the script in bytes, K, M and G suffixes are allowed", "64K", "", {}, false, "size"}},
+		{ "shape", { "What the script is made of", "mixed", "", {
+			{ "mixed", "A bit of everything" },
+			{ "nesting", "Deeply nested IF and SWITCH blocks" },
+			{ "literals", "Huge struct and array literals" },
+			{ "random", "RANDOMs with long weight lists" },
+			{ "identifiers", "Every name distinct, filling the checksum table" },
+			{ "strings", "Long strings full of escapes" },
+			{ "large", "IF and SWITCH blocks too big for short jumps" },
+		}, false}},
+		{ "depth", { "Deepest nesting of blocks and literals", "6", "", {}, false, "number"}},
+		{ "width", { "Elements in a struct or array, and weights in a RANDOM", "16", "", {}, false, "number"}},
+		{ "identifiers", { "Names to pick from", "4096", "", {}, false, "number"}},
+		{ "strings", { "Average string length", "32", "", {}, false, "number"}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	// Select settings
+	Generate::Settings settings;
+
+	static const std::unordered_map<std::string, Generate::Shape> shapes = {
+		{ "mixed", Generate::Shape::Mixed },
+		{ "nesting", Generate::Shape::Nesting },
+		{ "literals", Generate::Shape::Literals },
+		{ "random", Generate::Shape::Random },
+		{ "identifiers", Generate::Shape::Identifiers },
+		{ "strings", Generate::Shape::Strings },
+		{ "large", Generate::Shape::Large },
+	};
+	settings.shape = shapes.at(args["shape"]);
+
+	size_t seed, depth, width;
+	if (!ParseSize(args["seed"], seed) || !ParseSize(args["size"], settings.size) || !ParseSize(args["depth"], depth) ||
+		!ParseSize(args["width"], width) || !ParseSize(args["identifiers"], settings.identifiers) || !ParseSize(args["strings"], settings.string_length))
+	{
+		std::cerr << "Invalid number" << std::endl;
+		return 1;
+	}
+	if (width == 0 || settings.identifiers == 0)
+	{
+		std::cerr << "Width and identifiers must be at least 1" << std::endl;
+		return 1;
+	}
+	settings.seed = seed;
+	settings.depth = (unsigned int)depth;
+	settings.width = (unsigned int)width;
+
+	// Write out script
+	std::ofstream out_file(args["output"], std::ios::binary);
+	if (!out_file.is_open())
+	{
+		std::cerr << "Failed to open output file" << std::endl;
+		return 1;
+	}
+
+	Generate::Generator generator(settings);
+	size_t written = generator.Write(out_file);
+	if (!out_file)
+	{
+		std::cerr << "Failed to write output file" << std::endl;
+		return 1;
+	}
+
+	std::cout << "Generated " << written << " bytes" << std::endl;
+	return 0;
+}
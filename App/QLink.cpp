@@ -0,0 +1,333 @@
+#include <QScript/QCompile.h>
+#include <QScript/QLink.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <sstream>
+
+#include "ArgsParse.h"
+#include "Tools.h"
+
+// Unit cache
+// Each script's compile is kept in a file of the cache directory, named after the script's path
+// A file is only used while its key matches, the key covers the source, its name, the target and the options
+//   Layout: magic, 64-bit key, 32-bit bytecode, symbols and source map sizes, then those three
+namespace LinkCache
+{
+	static const char MAGIC[4] = { 'Q', 'L', 'C', '1' }; // Change with the compiler's output, so old units are compiled again
+
+	// FNV-1a
+	static uint64_t Hash(uint64_t hash, const void *data, size_t size)
+	{
+		const unsigned char *bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+		return hash;
+	}
+
+	static uint64_t Key(const std::string &source, const std::string &name, QScript::Target target, const QScript::CompileOptions &options)
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+		uint64_t sizes[2] = { source.size(), name.size() };
+		unsigned char settings[4] = { (unsigned char)target, options.optimize_branches, options.strip_checksum_names, options.source_map };
+		hash = Hash(hash, sizes, sizeof(sizes));
+		hash = Hash(hash, source.data(), source.size());
+		hash = Hash(hash, name.data(), name.size());
+		return Hash(hash, settings, sizeof(settings));
+	}
+
+	static std::filesystem::path Path(const std::filesystem::path &root, const std::string &input)
+	{
+		std::string name = std::filesystem::absolute(input).lexically_normal().string();
+		char file_name[32];
+		std::snprintf(file_name, sizeof(file_name), "%016llX.qbc", (unsigned long long)Hash(0xCBF29CE484222325ull, name.data(), name.size()));
+		return root / file_name;
+	}
+
+	static void PutInt(std::string &data, uint64_t value, int size)
+	{
+		for (int i = 0; i < size; i++)
+			data.push_back((char)((value >> (i * 8)) & 0xFF));
+	}
+
+	static uint64_t GetInt(const char *data, int size)
+	{
+		uint64_t value = 0;
+		for (int i = 0; i < size; i++)
+			value |= (uint64_t)(unsigned char)data[i] << (i * 8);
+		return value;
+	}
+
+	// Reads a unit back, returning false if it isn't there or is out of date
+	static bool Read(const std::filesystem::path &path, uint64_t key, QScript::CompileResult &unit)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open())
+			return false;
+
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+		std::string data = buffer.str();
+
+		static constexpr size_t HEADER_SIZE = 4 + 8 + 3 * 4;
+		if (data.size() < HEADER_SIZE || data.compare(0, 4, MAGIC, 4) != 0 || GetInt(data.data() + 4, 8) != key)
+			return false;
+
+		size_t sizes[3];
+		for (int i = 0; i < 3; i++)
+			sizes[i] = (size_t)GetInt(data.data() + 12 + i * 4, 4);
+		if (data.size() != HEADER_SIZE + sizes[0] + sizes[1] + sizes[2])
+			return false;
+
+		const char *p = data.data() + HEADER_SIZE;
+		unit.bytecode.assign(p, p + sizes[0]);
+		p += sizes[0];
+		unit.symbols = (sizes[1] != 0) ? QScript::ReadSymbols((void*)p, (void*)(p + sizes[1])) : QScript::Symbols();
+		p += sizes[1];
+		unit.source_map = (sizes[2] != 0) ? QScript::ReadSourceMap(p, p + sizes[2]) : QScript::SourceMap();
+		return true;
+	}
+
+	// Writes a unit out, through a temporary file so a unit is never read half written
+	static bool Write(const std::filesystem::path &path, uint64_t key, const QScript::CompileResult &unit)
+	{
+		std::vector<unsigned char> symbols, source_map;
+		if (!unit.symbols.empty())
+			symbols = QScript::WriteSymbols(unit.symbols);
+		if (!unit.source_map.entries.empty() || !unit.source_map.files.empty())
+			source_map = QScript::WriteSourceMap(unit.source_map);
+
+		std::string data(MAGIC, 4);
+		PutInt(data, key, 8);
+		PutInt(data, unit.bytecode.size(), 4);
+		PutInt(data, symbols.size(), 4);
+		PutInt(data, source_map.size(), 4);
+		data.append(unit.bytecode.begin(), unit.bytecode.end());
+		data.append(symbols.begin(), symbols.end());
+		data.append(source_map.begin(), source_map.end());
+
+		std::filesystem::path temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary);
+			if (!file.is_open() || !file.write(data.data(), data.size()))
+				return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temp, path, error);
+		return !error;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "input", { "List of scripts and binaries to link, one per line", "", "txt", {}, true}},
+		{ "output", { "Output binary", "", "qb", {}, true}},
+		{ "target", { "Script target", "", "", { { "thug1", "Tony Hawk's Underground" }, {"thug2", "Tony Hawk's Underground 2"} }, true}},
+		{ "optimize", { "Optimize branches", "", "", {}, false}},
+		{ "symbols", { "Strip checksum names out to a symbol sidecar", "", "qbsym", {}, false}},
+		{ "sourcemap", { "Bytecode offset to source line map", "", "qbmap", {}, false}},
+		{ "cache", { "Directory to keep each script's compile in, scripts that haven't changed aren't compiled again", "", "", {}, false, "directory"}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	try
+	{
+		// Read in input list
+		std::vector<std::string> inputs;
+		{
+			std::ifstream file(args["input"]);
+			if (!file.is_open())
+			{
+				std::cerr << "Failed to open input list" << std::endl;
+				return 1;
+			}
+
+			std::string line;
+			while (std::getline(file, line))
+			{
+				if (!line.empty() && line.back() == '\r')
+					line.pop_back();
+				if (!line.empty())
+					inputs.push_back(line);
+			}
+		}
+
+		// Select target
+		QScript::Target target;
+		if (args["target"] == "thug1")
+			target = QScript::Target::THUG1;
+		else if (args["target"] == "thug2")
+			target = QScript::Target::THUG2;
+		else
+		{
+			std::cerr << "Invalid target" << std::endl;
+			return 1;
+		}
+
+		// Select options
+		QScript::CompileOptions options;
+		options.optimize_branches = args.find("optimize") != args.end();
+		options.strip_checksum_names = args.find("symbols") != args.end();
+		options.source_map = args.find("sourcemap") != args.end();
+
+		// Make unit cache
+		std::filesystem::path cache_root;
+		if (args.find("cache") != args.end())
+		{
+			cache_root = args["cache"];
+			std::error_code error;
+			std::filesystem::create_directories(cache_root, error);
+			if (error)
+			{
+				std::cerr << "Failed to make cache directory: " << error.message() << std::endl;
+				return 1;
+			}
+		}
+
+		// Compile each script on its own on a pool of threads, each with its own compiler session, binaries are linked as they are
+		// Failures are reported in input order once every unit is done
+		std::vector<QScript::CompileResult> units(inputs.size());
+		std::vector<std::string> errors(inputs.size());
+		std::vector<char> cached(inputs.size(), 0);
+
+		Tools::RunPool<QScript::Compiler>(inputs.size(), [&](size_t i, QScript::Compiler &compiler)
+			{
+				const std::string &input = inputs[i];
+				bool binary = input.size() >= 3 && input.compare(input.size() - 3, 3, ".qb") == 0;
+
+				std::ifstream file(input, binary ? std::ios::binary : std::ios::in);
+				if (!file.is_open())
+				{
+					errors[i] = "Failed to open input file " + input;
+					return;
+				}
+
+				std::stringstream buffer;
+				buffer << file.rdbuf();
+
+				if (binary)
+				{
+					std::string data = buffer.str();
+					units[i].bytecode.assign(data.begin(), data.end());
+					return;
+				}
+
+				// Take the unit from the cache if its source and options haven't changed
+				std::string source = buffer.str();
+				QScript::CompileOptions unit_options = options;
+				unit_options.source_name = input;
+
+				uint64_t key = 0;
+				std::filesystem::path cache_path;
+				if (!cache_root.empty())
+				{
+					key = LinkCache::Key(source, input, target, unit_options);
+					cache_path = LinkCache::Path(cache_root, input);
+					try
+					{
+						if (LinkCache::Read(cache_path, key, units[i]))
+						{
+							cached[i] = 1;
+							return;
+						}
+					}
+					catch (const std::exception &)
+					{
+						// Damaged, it's compiled and written again
+					}
+				}
+
+				try
+				{
+					compiler.Compile(source, target, unit_options, units[i]);
+				}
+				catch (const std::exception &e)
+				{
+					errors[i] = "QScript compilation failed: " + input + ": " + e.what();
+					return;
+				}
+
+				// A unit that can't be cached is compiled again next time
+				if (!cache_root.empty())
+					LinkCache::Write(cache_path, key, units[i]);
+			});
+
+		bool failed = false;
+		for (const auto &error : errors)
+		{
+			if (!error.empty())
+			{
+				std::cerr << error << std::endl;
+				failed = true;
+			}
+		}
+		if (failed)
+			return 1;
+
+		if (!cache_root.empty())
+		{
+			size_t hits = std::count(cached.begin(), cached.end(), 1);
+			std::cout << "Compiled " << inputs.size() - hits << " units, took " << hits << " from the cache" << std::endl;
+		}
+
+		// Link
+		QScript::CompileResult out;
+		QScript::Link(units, out);
+
+		// Write out file
+		std::ofstream outFile(args["output"], std::ios::binary);
+		if (!outFile.is_open())
+		{
+			std::cerr << "Failed to open output file" << std::endl;
+			return 1;
+		}
+		outFile.write((const char*)out.bytecode.data(), out.bytecode.size());
+
+		// Write out symbols
+		if (args.find("symbols") != args.end())
+		{
+			std::ofstream symbols_file(args["symbols"], std::ios::binary);
+			if (!symbols_file.is_open())
+			{
+				std::cerr << "Failed to open symbols file" << std::endl;
+				return 1;
+			}
+
+			std::vector<unsigned char> sidecar = QScript::WriteSymbols(out.symbols);
+			symbols_file.write((const char*)sidecar.data(), sidecar.size());
+		}
+
+		// Write out source map
+		if (args.find("sourcemap") != args.end())
+		{
+			std::ofstream source_map_file(args["sourcemap"], std::ios::binary);
+			if (!source_map_file.is_open())
+			{
+				std::cerr << "Failed to open source map file" << std::endl;
+				return 1;
+			}
+
+			std::vector<unsigned char> sidecar = QScript::WriteSourceMap(out.source_map);
+			source_map_file.write((const char*)sidecar.data(), sidecar.size());
+		}
+	}
+	catch (const std::exception &e)
+	{
+		std::cerr << "QScript linking failed: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
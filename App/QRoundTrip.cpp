@@ -0,0 +1,277 @@
+#include <QScript/QCompile.h>
+#include <QScript/QDecompile.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "QBinary.h"
+
+#include "ArgsParse.h"
+#include "Tools.h"
+#include "Trace.h"
+
+namespace RoundTrip
+{
+	using Clock = std::chrono::steady_clock;
+
+	enum Stage
+	{
+		Read,
+		Decompile,
+		Compile,
+		Compare,
+		NumStages,
+	};
+
+	static const char *stage_names[NumStages] = { "read", "decompile", "compile", "compare" };
+
+	struct Result
+	{
+		std::string problem; // Empty if the round trip matched
+		double seconds[NumStages] = {};
+	};
+
+	struct Worker
+	{
+		QScript::Compiler compiler;
+		QScript::Decompiler decompiler;
+		QScript::CompileResult compiled;
+		std::vector<char> data;
+		std::vector<std::pair<uint32_t, std::string_view>> names[2];
+	};
+
+	// Binaries with fast IF, ELSE or CASE jumps are THUG2, those with the long forms are THUG1
+	// Binaries with neither compile the same for both
+	static QScript::Target DetectTarget(char *p_start, char *p_end)
+	{
+		for (char *p = p_start; p != nullptr; p = QScript::SkipToken(p_start, p_end, p))
+		{
+			switch ((QScript::Token)*p)
+			{
+				case QScript::Token::FastIf:
+				case QScript::Token::FastElse:
+				case QScript::Token::ShortJump:
+					return QScript::Target::THUG2;
+				case QScript::Token::KeywordIf:
+				case QScript::Token::KeywordElse:
+					return QScript::Target::THUG1;
+				case QScript::Token::KeywordCase:
+				case QScript::Token::KeywordDefault:
+				{
+					// THUG2 follows every CASE with a short jump to the next one
+					char *p_next = QScript::SkipToken(p_start, p_end, p);
+					if (p_next != nullptr && (QScript::Token)*p_next != QScript::Token::ShortJump)
+						return QScript::Target::THUG1;
+					break;
+				}
+				default:
+					break;
+			}
+		}
+		return QScript::Target::THUG2;
+	}
+
+	// Compares everything but ChecksumName records token by token, then compares the records as sets
+	static std::string CompareBinaries(char *a_start, char *a_end, char *b_start, char *b_end, std::vector<std::pair<uint32_t, std::string_view>> (&names)[2])
+	{
+		names[0].clear();
+		names[1].clear();
+
+		// Steps to the next token that isn't a ChecksumName, collecting the names on the way
+		auto next = [](char *p_start, char *p_end, char *p, std::vector<std::pair<uint32_t, std::string_view>> &found, QScript::Error &error) -> char *
+			{
+				while (p != nullptr && (QScript::Token)*p == QScript::Token::ChecksumName)
+				{
+					char *p_next = QScript::SkipToken(p_start, p_end, p, error);
+					if (error)
+						return nullptr;
+					found.emplace_back(QScript::GetUnsignedInteger(p_start, p_end, p + 1), std::string_view(p + 5));
+					p = p_next;
+				}
+				return p;
+			};
+
+		QScript::Error error;
+		char *a = next(a_start, a_end, a_start, names[0], error);
+		char *b = next(b_start, b_end, b_start, names[1], error);
+		while (a != nullptr && b != nullptr)
+		{
+			char *a_next = QScript::SkipToken(a_start, a_end, a, error);
+			char *b_next = QScript::SkipToken(b_start, b_end, b, error);
+			if (error)
+				return "Failed to read binary: " + error.Message();
+
+			size_t a_size = (a_next != nullptr) ? (a_next - a) : 1;
+			size_t b_size = (b_next != nullptr) ? (b_next - b) : 1;
+			if (a_size != b_size || std::memcmp(a, b, a_size) != 0)
+			{
+				return "First difference at token offset " + std::to_string(a - a_start) +
+					" (token " + std::to_string((unsigned char)*a) + ", recompiled token " + std::to_string((unsigned char)*b) + " at " + std::to_string(b - b_start) + ")";
+			}
+
+			a = next(a_start, a_end, a_next, names[0], error);
+			b = next(b_start, b_end, b_next, names[1], error);
+		}
+		if (error)
+			return "Failed to read binary: " + error.Message();
+		if (a != nullptr || b != nullptr)
+			return "First difference at token offset " + std::to_string((a != nullptr ? a : a_end) - a_start) + " (one binary ends early)";
+
+		// ChecksumName records can come in any order
+		for (auto &found : names)
+		{
+			std::sort(found.begin(), found.end());
+			found.erase(std::unique(found.begin(), found.end()), found.end());
+		}
+		if (names[0] != names[1])
+		{
+			size_t i = 0;
+			while (i < names[0].size() && i < names[1].size() && names[0][i] == names[1][i])
+				i++;
+			const auto &name = (i < names[0].size()) ? names[0][i] : names[1][i];
+			return "Checksum names differ at " + std::string(name.second) + " (" + std::to_string(names[0].size()) + " names, " + std::to_string(names[1].size()) + " recompiled)";
+		}
+		return std::string();
+	}
+
+	static Result Run(const std::filesystem::path &path, Worker &worker, const std::string &target_name, const QScript::Symbols &dictionary)
+	{
+		QSCRIPT_TRACE_SCOPE("RoundTrip", path.string());
+		Result result;
+		auto start = Clock::now();
+		auto lap = [&result, &start](Stage stage)
+			{
+				auto now = Clock::now();
+				result.seconds[stage] += std::chrono::duration<double>(now - start).count();
+				start = now;
+			};
+
+		// Read in file
+		{
+			QSCRIPT_TRACE_SCOPE("ReadInput");
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file.is_open())
+			{
+				result.problem = "Failed to open file";
+				return result;
+			}
+
+			size_t size = file.tellg();
+			worker.data.resize(size);
+
+			file.seekg(0, std::ios::beg);
+			file.read(worker.data.data(), size);
+		}
+		char *p_start = worker.data.data();
+		char *p_end = p_start + worker.data.size();
+		lap(Read);
+
+		// Decompile
+		std::string_view text;
+		QScript::Error error;
+		if (!worker.decompiler.Decompile(std::span<const std::byte>((const std::byte *)p_start, worker.data.size()), text, dictionary, error))
+		{
+			result.problem = "Decompile failed: " + error.Message();
+			return result;
+		}
+		lap(Decompile);
+
+		// Recompile
+		QScript::Target target;
+		if (target_name == "thug1")
+			target = QScript::Target::THUG1;
+		else if (target_name == "thug2")
+			target = QScript::Target::THUG2;
+		else
+			target = DetectTarget(p_start, p_end);
+
+		QScript::CompileOptions options;
+		if (!dictionary.empty())
+			options.shared_symbols = &dictionary;
+		if (!worker.compiler.Compile(text, target, options, worker.compiled, error))
+		{
+			result.problem = "Recompile failed: " + error.Message();
+			return result;
+		}
+		lap(Compile);
+
+		// Compare
+		QSCRIPT_TRACE_SCOPE("Compare");
+		char *b_start = (char *)worker.compiled.bytecode.data();
+		result.problem = CompareBinaries(p_start, p_end, b_start, b_start + worker.compiled.bytecode.size(), worker.names);
+		lap(Compare);
+		return result;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "input", { "Input binary, or a directory to round trip every binary under", "", "qb", {}, true}},
+		{ "target", { "Recompile target", "auto", "", { { "auto", "Picked from the binary's IF tokens" }, { "thug1", "Tony Hawk's Underground" }, {"thug2", "Tony Hawk's Underground 2"} }, false}},
+		{ "dictionary", { "Shared symbol dictionary, used to decompile and recompile", "", "qbsym", {}, false}},
+		{ "trace", { "Write a Chrome trace of every thread, needs a build with QSCRIPT_TRACE", "", "json", {}, false}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	// Read in dictionary
+	QScript::Symbols dictionary;
+	if (args.find("dictionary") != args.end() && !Tools::ReadSymbolsFile(args["dictionary"], dictionary))
+		return 1;
+
+	// Collect binaries
+	std::vector<std::filesystem::path> inputs;
+	if (!Tools::CollectBinaries(args["input"], inputs))
+		return 1;
+
+	// Round trip on a pool of threads, each with its own compiler, decompiler and buffers
+	if (!Tracing::Start(args))
+		return 1;
+
+	std::vector<RoundTrip::Result> results(inputs.size());
+	auto start = RoundTrip::Clock::now();
+
+	unsigned int threads = Tools::RunPool<RoundTrip::Worker>(inputs.size(), [&](size_t i, RoundTrip::Worker &worker)
+		{
+			try
+			{
+				results[i] = RoundTrip::Run(inputs[i], worker, args["target"], dictionary);
+			}
+			catch (const std::exception &e)
+			{
+				results[i].problem = std::string("Round trip failed: ") + e.what();
+			}
+		});
+
+	double wall = std::chrono::duration<double>(RoundTrip::Clock::now() - start).count();
+	if (!Tracing::Stop(args))
+		return 1;
+
+	// Report in path order
+	size_t failed = 0;
+	double totals[RoundTrip::NumStages] = {};
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		for (int stage = 0; stage < RoundTrip::NumStages; stage++)
+			totals[stage] += results[i].seconds[stage];
+		if (results[i].problem.empty())
+			continue;
+		std::cout << inputs[i].string() << ": " << results[i].problem << std::endl;
+		failed++;
+	}
+
+	std::cout << "Round tripped " << inputs.size() << " binaries on " << threads << " threads, " << failed << " failed" << std::endl;
+	for (int stage = 0; stage < RoundTrip::NumStages; stage++)
+		std::cout << "  " << RoundTrip::stage_names[stage] << ": " << totals[stage] * 1000.0 << " ms" << std::endl;
+	std::cout << "  wall: " << wall * 1000.0 << " ms" << std::endl;
+	return failed != 0;
+}
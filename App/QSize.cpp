@@ -0,0 +1,423 @@
+#include <QScript/QStats.h>
+#include <QScript/QSymbols.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "QBinary.h"
+
+#include "ArgsParse.h"
+#include "Tools.h"
+
+namespace Size
+{
+	// A SCRIPT or global definition
+	struct Definition
+	{
+		size_t file = 0;
+		uint32_t checksum = 0;
+		std::string name;
+		bool is_script = false;
+
+		size_t offset = 0;
+		size_t bytes = 0;
+		size_t string_bytes = 0; // String and LocalString tokens
+		size_t jump_bytes = 0; // Jump and ShortJump tokens, FastIf and FastElse offsets and RANDOM jump tables
+		double checksum_share = 0.0; // ChecksumName records of the names used, split between the definitions using them
+
+		std::vector<std::pair<unsigned char, size_t>> tokens; // Count of each token type used
+		std::vector<uint32_t> names; // Checksums used, for splitting the checksum table
+	};
+
+	struct FileProfile
+	{
+		std::string problem; // Empty if the binary was read
+		size_t bytes = 0;
+		size_t checksum_table_bytes = 0;
+		size_t unshared_checksum_bytes = 0; // ChecksumName records no definition uses
+		size_t overhead_bytes = 0; // Everything outside of definitions and the checksum table
+		std::vector<Definition> definitions;
+		size_t token_counts[256] = {};
+		size_t token_bytes[256] = {};
+	};
+
+	struct Worker
+	{
+		std::vector<char> data;
+		std::vector<std::pair<uint32_t, std::string_view>> checksum_strings;
+		std::vector<QScript::Definition> extents;
+		size_t token_counts[256] = {};
+	};
+
+	static std::string NameOf(uint32_t checksum, const std::vector<std::pair<uint32_t, std::string_view>> &checksum_strings, const QScript::Symbols &dictionary)
+	{
+		auto it = std::lower_bound(checksum_strings.begin(), checksum_strings.end(), checksum, [](const std::pair<uint32_t, std::string_view> &a, uint32_t b) { return a.first < b; });
+		if (it != checksum_strings.end() && it->first == checksum)
+			return std::string(it->second);
+
+		auto find = dictionary.find(checksum);
+		if (find != dictionary.end())
+			return find->second;
+
+		char hex[16];
+		std::snprintf(hex, sizeof(hex), "0x%08X", checksum);
+		return hex;
+	}
+
+	// Bytes of a token that only serve to jump
+	static size_t JumpBytes(char *p_start, char *p_end, char *p_token)
+	{
+		switch ((QScript::Token)*p_token)
+		{
+			case QScript::Token::Jump:
+				return 5;
+			case QScript::Token::ShortJump:
+				return 3;
+			case QScript::Token::FastIf:
+			case QScript::Token::FastElse:
+				return 2;
+			case QScript::Token::KeywordRandom:
+			case QScript::Token::KeywordRandom2:
+			case QScript::Token::KeywordRandomNoRepeat:
+			case QScript::Token::KeywordRandomPermute:
+				return 4 * (size_t)QScript::GetUnsignedInteger(p_start, p_end, p_token + 1);
+			default:
+				return 0;
+		}
+	}
+
+	static void Profile(const std::filesystem::path &path, size_t file, FileProfile &profile, Worker &worker, const QScript::Symbols &dictionary)
+	{
+		// Read in file
+		{
+			std::ifstream stream(path, std::ios::binary | std::ios::ate);
+			if (!stream.is_open())
+			{
+				profile.problem = "Failed to open file";
+				return;
+			}
+
+			size_t size = stream.tellg();
+			worker.data.resize(size);
+
+			stream.seekg(0, std::ios::beg);
+			stream.read(worker.data.data(), size);
+		}
+		char *p_start = worker.data.data();
+		char *p_end = p_start + worker.data.size();
+		profile.bytes = worker.data.size();
+
+		QScript::Error error;
+		if (!QScript::CheckBinary(p_start, p_end, error))
+		{
+			profile.problem = error.Message();
+			return;
+		}
+		QScript::GetChecksumStrings(p_start, p_end, p_start, worker.checksum_strings);
+
+		// Walk the tokens, adding up each definition
+		QScript::GetDefinitions(p_start, p_end, worker.extents);
+		profile.definitions.resize(worker.extents.size());
+		for (size_t i = 0; i < worker.extents.size(); i++)
+		{
+			const auto &extent = worker.extents[i];
+			auto &definition = profile.definitions[i];
+			definition.file = file;
+			definition.offset = extent.start;
+			definition.bytes = extent.end - extent.start;
+			definition.is_script = extent.is_script;
+			definition.checksum = extent.checksum;
+			definition.name = extent.named ? NameOf(extent.checksum, worker.checksum_strings, dictionary) : "(unnamed)";
+		}
+
+		std::unordered_map<uint32_t, size_t> record_bytes;
+		size_t next_extent = 0;
+		Definition *definition = nullptr;
+		auto finish = [&]()
+			{
+				for (int i = 0; i < 256; i++)
+				{
+					if (worker.token_counts[i] != 0)
+						definition->tokens.emplace_back((unsigned char)i, worker.token_counts[i]);
+					worker.token_counts[i] = 0;
+				}
+				std::sort(definition->names.begin(), definition->names.end());
+				definition->names.erase(std::unique(definition->names.begin(), definition->names.end()), definition->names.end());
+				definition = nullptr;
+			};
+
+		for (char *p_token = p_start; p_token != nullptr;)
+		{
+			char *p_next = QScript::SkipToken(p_start, p_end, p_token);
+			QScript::Token token = (QScript::Token)*p_token;
+			size_t offset = p_token - p_start;
+			size_t size = (p_next != nullptr ? p_next : p_token + 1) - p_token;
+
+			profile.token_counts[(unsigned char)token]++;
+			profile.token_bytes[(unsigned char)token] += size;
+
+			// Step into and out of definitions
+			if (definition != nullptr && offset >= worker.extents[next_extent - 1].end)
+				finish();
+			if (definition == nullptr && next_extent < worker.extents.size() && offset >= worker.extents[next_extent].start)
+				definition = &profile.definitions[next_extent++];
+
+			// Tokens outside of definitions are line ends and the checksum table
+			if (definition == nullptr)
+			{
+				if (token == QScript::Token::ChecksumName)
+				{
+					profile.checksum_table_bytes += size;
+					record_bytes[QScript::GetUnsignedInteger(p_start, p_end, p_token + 1)] += size;
+				}
+				else
+				{
+					profile.overhead_bytes += size;
+				}
+				p_token = p_next;
+				continue;
+			}
+
+			// Count the token
+			worker.token_counts[(unsigned char)token]++;
+			definition->jump_bytes += JumpBytes(p_start, p_end, p_token);
+			if (token == QScript::Token::String || token == QScript::Token::LocalString)
+				definition->string_bytes += size;
+			else if (token == QScript::Token::Name)
+				definition->names.push_back(QScript::GetUnsignedInteger(p_start, p_end, p_token + 1));
+			p_token = p_next;
+		}
+		if (definition != nullptr)
+			finish();
+
+		// Split each ChecksumName record between the definitions using its name
+		std::unordered_map<uint32_t, size_t> users;
+		for (const auto &found : profile.definitions)
+		{
+			for (uint32_t checksum : found.names)
+				users[checksum]++;
+		}
+		for (auto &found : profile.definitions)
+		{
+			for (uint32_t checksum : found.names)
+			{
+				auto record = record_bytes.find(checksum);
+				if (record != record_bytes.end())
+					found.checksum_share += (double)record->second / users[checksum];
+			}
+			found.names.clear();
+			found.names.shrink_to_fit();
+		}
+		for (const auto &record : record_bytes)
+		{
+			if (users.find(record.first) == users.end())
+				profile.unshared_checksum_bytes += record.second;
+		}
+	}
+
+	static std::string TokenName(unsigned char token)
+	{
+		const char *name = QScript::Stats::TokenName(token);
+		return name != nullptr ? std::string(name) : std::to_string(token);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "input", { "Input binary, or a directory to profile every binary under", "", "qb", {}, true}},
+		{ "dictionary", { "Shared symbol dictionary, for names the binaries don't have", "", "qbsym", {}, false}},
+		{ "sort", { "What to sort definitions by, largest first", "size", "", {
+			{ "size", "Bytes of the definition" },
+			{ "total", "Bytes of the definition and its share of the checksum table" },
+			{ "strings", "Bytes of string literals" },
+			{ "jumps", "Bytes spent on jumps" },
+			{ "checksums", "Share of the checksum table" },
+		}, false}},
+		{ "top", { "Definitions to list, 0 lists all of them", "50", "", {}, false, "count"}},
+		{ "format", { "Output format", "text", "", { { "text", "Readable tables" }, { "json", "JSON object, with every definition's token histogram" } }, false}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	size_t top;
+	try
+	{
+		top = std::stoull(args["top"]);
+	}
+	catch (const std::exception &)
+	{
+		std::cerr << "Invalid top count" << std::endl;
+		return 1;
+	}
+
+	// Read in dictionary
+	QScript::Symbols dictionary;
+	if (args.find("dictionary") != args.end() && !Tools::ReadSymbolsFile(args["dictionary"], dictionary))
+		return 1;
+
+	// Collect binaries
+	std::vector<std::filesystem::path> inputs;
+	if (!Tools::CollectBinaries(args["input"], inputs))
+		return 1;
+
+	// Profile on a pool of threads, each with its own read buffer
+	std::vector<Size::FileProfile> profiles(inputs.size());
+
+	Tools::RunPool<Size::Worker>(inputs.size(), [&](size_t i, Size::Worker &worker)
+		{
+			try
+			{
+				Size::Profile(inputs[i], i, profiles[i], worker, dictionary);
+			}
+			catch (const std::exception &e)
+			{
+				profiles[i].problem = e.what();
+			}
+		});
+
+	// Aggregate
+	size_t failed = 0;
+	size_t total_bytes = 0, total_checksum_table = 0, total_unshared = 0, total_overhead = 0, total_strings = 0, total_jumps = 0;
+	size_t token_counts[256] = {};
+	size_t token_bytes[256] = {};
+	std::vector<const Size::Definition*> definitions;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		const auto &profile = profiles[i];
+		if (!profile.problem.empty())
+		{
+			std::cerr << inputs[i].string() << ": " << profile.problem << std::endl;
+			failed++;
+			continue;
+		}
+
+		total_bytes += profile.bytes;
+		total_checksum_table += profile.checksum_table_bytes;
+		total_unshared += profile.unshared_checksum_bytes;
+		total_overhead += profile.overhead_bytes;
+		for (int j = 0; j < 256; j++)
+		{
+			token_counts[j] += profile.token_counts[j];
+			token_bytes[j] += profile.token_bytes[j];
+		}
+		for (const auto &definition : profile.definitions)
+		{
+			total_strings += definition.string_bytes;
+			total_jumps += definition.jump_bytes;
+			definitions.push_back(&definition);
+		}
+	}
+
+	// Sort definitions, largest first
+	auto key = [&args](const Size::Definition &definition) -> double
+		{
+			const std::string &sort = args["sort"];
+			if (sort == "total")
+				return (double)definition.bytes + definition.checksum_share;
+			if (sort == "strings")
+				return (double)definition.string_bytes;
+			if (sort == "jumps")
+				return (double)definition.jump_bytes;
+			if (sort == "checksums")
+				return definition.checksum_share;
+			return (double)definition.bytes;
+		};
+	std::stable_sort(definitions.begin(), definitions.end(), [&key](const Size::Definition *a, const Size::Definition *b) { return key(*a) > key(*b); });
+	if (top != 0 && definitions.size() > top)
+		definitions.resize(top);
+
+	// Token types, largest first
+	std::vector<unsigned char> types;
+	for (int i = 0; i < 256; i++)
+	{
+		if (token_counts[i] != 0)
+			types.push_back((unsigned char)i);
+	}
+	std::stable_sort(types.begin(), types.end(), [&token_bytes](unsigned char a, unsigned char b) { return token_bytes[a] > token_bytes[b]; });
+
+	// Write out report
+	if (args["format"] == "json")
+	{
+		std::ostream &out = std::cout;
+		out << "{\n";
+		out << "\t\"files\": " << inputs.size() - failed << ",\n";
+		out << "\t\"failed\": " << failed << ",\n";
+		out << "\t\"bytes\": " << total_bytes << ",\n";
+		out << "\t\"checksum_table_bytes\": " << total_checksum_table << ",\n";
+		out << "\t\"unshared_checksum_bytes\": " << total_unshared << ",\n";
+		out << "\t\"overhead_bytes\": " << total_overhead << ",\n";
+		out << "\t\"string_bytes\": " << total_strings << ",\n";
+		out << "\t\"jump_bytes\": " << total_jumps << ",\n";
+		out << "\t\"tokens\": {";
+		for (size_t i = 0; i < types.size(); i++)
+			out << (i == 0 ? " " : ", ") << "\"" << Size::TokenName(types[i]) << "\": { \"count\": " << token_counts[types[i]] << ", \"bytes\": " << token_bytes[types[i]] << " }";
+		out << (types.empty() ? "},\n" : " },\n");
+		out << "\t\"definitions\": [\n";
+		for (size_t i = 0; i < definitions.size(); i++)
+		{
+			const auto &definition = *definitions[i];
+			out << "\t\t{ \"file\": ";
+			Tools::WriteJsonString(out, inputs[definition.file].string());
+			out << ", \"name\": ";
+			Tools::WriteJsonString(out, definition.name);
+			out << ", \"kind\": \"" << (definition.is_script ? "script" : "global") << "\"";
+			out << ", \"offset\": " << definition.offset;
+			out << ", \"bytes\": " << definition.bytes;
+			out << ", \"string_bytes\": " << definition.string_bytes;
+			out << ", \"jump_bytes\": " << definition.jump_bytes;
+			out << ", \"checksum_share\": " << definition.checksum_share;
+			out << ", \"tokens\": {";
+			for (size_t j = 0; j < definition.tokens.size(); j++)
+				out << (j == 0 ? " " : ", ") << "\"" << Size::TokenName(definition.tokens[j].first) << "\": " << definition.tokens[j].second;
+			out << (definition.tokens.empty() ? "}" : " }");
+			out << " }" << (i + 1 < definitions.size() ? "," : "") << "\n";
+		}
+		out << "\t]\n";
+		out << "}\n";
+	}
+	else
+	{
+		std::ostream &out = std::cout;
+		auto percent = [total_bytes](double bytes) -> double
+			{
+				return total_bytes != 0 ? bytes * 100.0 / total_bytes : 0.0;
+			};
+
+		out << "Definitions (" << args["sort"] << "):" << std::endl;
+		for (const auto *definition : definitions)
+		{
+			char line[96];
+			std::snprintf(line, sizeof(line), "  %9zu %9zu %9zu %11.1f  ", definition->bytes, definition->string_bytes, definition->jump_bytes, definition->checksum_share);
+			out << line << (definition->is_script ? "SCRIPT " : "") << definition->name;
+			if (inputs.size() > 1)
+				out << " (" << inputs[definition->file].string() << ")";
+			out << std::endl;
+		}
+		out << "  (columns: bytes, string bytes, jump bytes, checksum table share)" << std::endl;
+
+		out << "Tokens:" << std::endl;
+		for (unsigned char type : types)
+		{
+			char line[96];
+			std::snprintf(line, sizeof(line), "  %9zu bytes %5.1f%% %9zu  ", token_bytes[type], percent((double)token_bytes[type]), token_counts[type]);
+			out << line << Size::TokenName(type) << std::endl;
+		}
+
+		out << "Totals:" << std::endl;
+		out << "  " << inputs.size() - failed << " binaries, " << total_bytes << " bytes" << std::endl;
+		out << "  strings: " << total_strings << " bytes (" << percent((double)total_strings) << "%)" << std::endl;
+		out << "  jumps: " << total_jumps << " bytes (" << percent((double)total_jumps) << "%)" << std::endl;
+		out << "  checksum table: " << total_checksum_table << " bytes (" << percent((double)total_checksum_table) << "%), " << total_unshared << " bytes of it for names no definition uses" << std::endl;
+		out << "  line ends and end of file: " << total_overhead << " bytes (" << percent((double)total_overhead) << "%)" << std::endl;
+	}
+	return failed != 0;
+}
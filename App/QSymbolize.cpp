@@ -0,0 +1,167 @@
+#include <QScript/QDecompile.h>
+#include <QScript/QStats.h>
+#include <QScript/QSymbolize.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ArgsParse.h"
+#include "Tools.h"
+
+// Reads offsets separated by whitespace, in decimal or with a 0x prefix in hex
+static bool ReadOffsets(std::istream &stream, std::vector<size_t> &offsets)
+{
+	std::string text;
+	while (stream >> text)
+	{
+		size_t end = 0;
+		try
+		{
+			offsets.push_back((size_t)std::stoull(text, &end, 0));
+		}
+		catch (const std::exception &)
+		{
+			end = 0;
+		}
+		if (end != text.size())
+		{
+			std::cerr << "Invalid offset: " << text << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "input", { "Input binary", "", "qb", {}, true}},
+		{ "offsets", { "Bytecode offsets, read from stdin if not given", "", "txt", {}, false}},
+		{ "dictionary", { "Shared symbol dictionary, for names the binary doesn't have", "", "qbsym", {}, false}},
+		{ "text", { "Print each offset's line of decompiled text", "", "", {}, false}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	using Clock = std::chrono::steady_clock;
+
+	// Read in dictionary
+	QScript::Symbols dictionary;
+	if (args.find("dictionary") != args.end() && !Tools::ReadSymbolsFile(args["dictionary"], dictionary))
+		return 1;
+
+	// Read in file
+	std::ifstream file(args["input"], std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to open input file" << std::endl;
+		return 1;
+	}
+
+	size_t size = file.tellg();
+	std::vector<char> data(size);
+
+	file.seekg(0, std::ios::beg);
+	file.read(data.data(), size);
+	std::span<const std::byte> binary((const std::byte *)data.data(), size);
+
+	// Read in offsets
+	std::vector<size_t> offsets;
+	if (args.find("offsets") != args.end())
+	{
+		std::ifstream offsets_file(args["offsets"]);
+		if (!offsets_file.is_open())
+		{
+			std::cerr << "Failed to open offsets file" << std::endl;
+			return 1;
+		}
+		if (!ReadOffsets(offsets_file, offsets))
+			return 1;
+	}
+	else if (!ReadOffsets(std::cin, offsets))
+	{
+		return 1;
+	}
+
+	// Index binary
+	auto start = Clock::now();
+	QScript::Symbolizer symbolizer;
+	QScript::Error error;
+	if (!symbolizer.Load(binary, dictionary, error))
+	{
+		std::cerr << "Failed to read binary: " << error.Message() << std::endl;
+		return 1;
+	}
+	auto indexed = Clock::now();
+
+	// Symbolize
+	std::vector<QScript::Symbol> symbols(offsets.size());
+	symbolizer.Symbolize(offsets, symbols);
+	auto symbolized = Clock::now();
+
+	// Split decompiled text into lines
+	QScript::Decompiler decompiler;
+	std::string_view text;
+	std::vector<std::string_view> lines;
+	if (args.find("text") != args.end())
+	{
+		if (!decompiler.Decompile(binary, text, dictionary, error))
+		{
+			std::cerr << "Failed to decompile binary: " << error.Message() << std::endl;
+			return 1;
+		}
+		for (size_t line_start = 0; line_start < text.size();)
+		{
+			size_t line_end = text.find('\n', line_start);
+			if (line_end == std::string_view::npos)
+				line_end = text.size();
+			lines.push_back(text.substr(line_start, line_end - line_start));
+			line_start = line_end + 1;
+		}
+	}
+
+	// Write out symbols
+	for (size_t i = 0; i < offsets.size(); i++)
+	{
+		const auto &symbol = symbols[i];
+		char hex[32];
+		std::snprintf(hex, sizeof(hex), "0x%zX", offsets[i]);
+		std::cout << hex << ": ";
+		if (!symbol.valid)
+		{
+			std::cout << "outside of the binary" << std::endl;
+			continue;
+		}
+
+		if (symbol.in_definition)
+		{
+			if (!symbol.name.empty())
+				std::cout << symbol.name;
+			else
+				std::snprintf(hex, sizeof(hex), "0x%08X", symbol.checksum), std::cout << hex;
+			std::snprintf(hex, sizeof(hex), "+0x%zX", symbol.relative);
+			std::cout << hex << (symbol.is_script ? " (script)" : " (global)");
+		}
+		else
+		{
+			std::cout << "between definitions";
+		}
+
+		const char *type = QScript::Stats::TokenName(symbol.type);
+		std::snprintf(hex, sizeof(hex), "0x%zX", symbol.token);
+		std::cout << ", line " << symbol.line << ", " << (type != nullptr ? type : "token") << " at " << hex;
+		if (symbol.line - 1 < lines.size())
+			std::cout << ": " << lines[symbol.line - 1];
+		std::cout << std::endl;
+	}
+
+	std::cerr << "Indexed in " << std::chrono::duration<double, std::milli>(indexed - start).count() << " ms, symbolized " << offsets.size() << " offsets in " <<
+		std::chrono::duration<double, std::milli>(symbolized - indexed).count() << " ms" << std::endl;
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <QScript/QVerify.h>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ArgsParse.h"
+#include "Tools.h"
+
+// Reads and verifies a binary, returning the problem found
+static std::string VerifyFile(const std::filesystem::path &path, QScript::Verifier &verifier, std::vector<char> &data)
+{
+	// Read in file
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+		return "Failed to open file";
+
+	size_t size = file.tellg();
+	data.resize(size);
+
+	file.seekg(0, std::ios::beg);
+	file.read(data.data(), size);
+
+	// Verify
+	QScript::Error error;
+	if (!verifier.Verify(std::span<const std::byte>((const std::byte *)data.data(), size), error))
+		return error.Message();
+	return std::string();
+}
+
+int main(int argc, char *argv[])
+{
+	// Parse arguments
+	static const std::unordered_map<std::string, ArgsParse::ArgumentDef> args_def = {
+		{ "input", { "Input binary, or a directory to verify every binary under", "", "qb", {}, true}},
+	};
+	std::unordered_map<std::string, std::string> args = ArgsParse::Parse(argc, argv, args_def);
+	if (args.empty())
+		return 0;
+
+	// Collect binaries
+	std::vector<std::filesystem::path> inputs;
+	if (!Tools::CollectBinaries(args["input"], inputs))
+		return 1;
+
+	// Verify on a pool of threads, each with its own verifier and read buffer
+	std::vector<std::string> problems(inputs.size());
+
+	struct Worker
+	{
+		QScript::Verifier verifier;
+		std::vector<char> data;
+	};
+	Tools::RunPool<Worker>(inputs.size(), [&](size_t i, Worker &worker)
+		{
+			problems[i] = VerifyFile(inputs[i], worker.verifier, worker.data);
+		});
+
+	// Report in path order
+	size_t failed = 0;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		if (problems[i].empty())
+			continue;
+		std::cout << inputs[i].string() << ": " << problems[i] << std::endl;
+		failed++;
+	}
+	std::cout << "Verified " << inputs.size() << " binaries, " << failed << " failed" << std::endl;
+	return failed != 0;
+}
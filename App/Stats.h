@@ -0,0 +1,169 @@
+#pragma once
+
+#include <QScript/QStats.h>
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+
+namespace Stats
+{
+	struct Phase
+	{
+		const char *name;
+		double seconds;
+		const QScript::Stats::Allocations &allocations;
+	};
+
+	struct Count
+	{
+		const char *name;
+		size_t value;
+	};
+
+	// Writes the stats for people to read, phases that didn't run and tokens that never appeared are left out
+	inline void WriteText(std::ostream &out, const QScript::Stats &stats)
+	{
+		const Phase phases[] = {
+			{ "lex", stats.lex_seconds, stats.lex_allocations },
+			{ "emit", stats.emit_seconds, stats.emit_allocations },
+			{ "finish", stats.finish_seconds, stats.finish_allocations },
+			{ "labels", stats.label_seconds, stats.label_allocations },
+			{ "checksums", stats.checksum_seconds, stats.checksum_allocations },
+			{ "decompile", stats.decompile_seconds, stats.decompile_allocations },
+		};
+		const Count counts[] = {
+			{ "input bytes", stats.input_bytes },
+			{ "output bytes", stats.output_bytes },
+			{ "source tokens", stats.source_tokens },
+			{ "peak token bytes", stats.peak_token_bytes },
+			{ "checksum entries", stats.checksum_entries },
+			{ "labels", stats.labels },
+			{ "unresolved checksums", stats.unresolved_checksums },
+		};
+
+		out << "Phases:" << std::endl;
+		double total = 0.0;
+		for (const auto &phase : phases)
+		{
+			if (phase.seconds == 0.0)
+				continue;
+			out << "  " << phase.name << ": " << phase.seconds * 1000.0 << " ms";
+			if (QScript::Stats::allocations_counted)
+			{
+				const auto &allocations = phase.allocations;
+				out << ", " << allocations.count << " allocations, " << allocations.bytes << " bytes, " << allocations.peak_bytes << " peak bytes";
+			}
+			out << std::endl;
+			total += phase.seconds;
+		}
+		out << "  total: " << total * 1000.0 << " ms" << std::endl;
+
+		out << "Counts:" << std::endl;
+		for (const auto &count : counts)
+			out << "  " << count.name << ": " << count.value << std::endl;
+
+		out << "Tokens:" << std::endl;
+		for (int i = 0; i < 256; i++)
+		{
+			if (stats.tokens[i] == 0)
+				continue;
+			const char *name = QScript::Stats::TokenName((unsigned char)i);
+			if (name != nullptr)
+				out << "  " << name << ": " << stats.tokens[i] << std::endl;
+			else
+				out << "  " << i << ": " << stats.tokens[i] << std::endl;
+		}
+	}
+
+	// Writes the stats as a JSON object, every field is always written
+	inline void WriteJson(std::ostream &out, const QScript::Stats &stats)
+	{
+		out << "{\n";
+		out << "\t\"lex_seconds\": " << stats.lex_seconds << ",\n";
+		out << "\t\"emit_seconds\": " << stats.emit_seconds << ",\n";
+		out << "\t\"finish_seconds\": " << stats.finish_seconds << ",\n";
+		out << "\t\"label_seconds\": " << stats.label_seconds << ",\n";
+		out << "\t\"checksum_seconds\": " << stats.checksum_seconds << ",\n";
+		out << "\t\"decompile_seconds\": " << stats.decompile_seconds << ",\n";
+		if (QScript::Stats::allocations_counted)
+		{
+			const Phase phases[] = {
+				{ "lex", 0.0, stats.lex_allocations },
+				{ "emit", 0.0, stats.emit_allocations },
+				{ "finish", 0.0, stats.finish_allocations },
+				{ "label", 0.0, stats.label_allocations },
+				{ "checksum", 0.0, stats.checksum_allocations },
+				{ "decompile", 0.0, stats.decompile_allocations },
+			};
+			for (const auto &phase : phases)
+			{
+				const auto &allocations = phase.allocations;
+				out << "\t\"" << phase.name << "_allocations\": { \"count\": " << allocations.count << ", \"bytes\": " << allocations.bytes << ", \"peak_bytes\": " << allocations.peak_bytes << " },\n";
+			}
+		}
+		out << "\t\"input_bytes\": " << stats.input_bytes << ",\n";
+		out << "\t\"output_bytes\": " << stats.output_bytes << ",\n";
+		out << "\t\"source_tokens\": " << stats.source_tokens << ",\n";
+		out << "\t\"peak_token_bytes\": " << stats.peak_token_bytes << ",\n";
+		out << "\t\"checksum_entries\": " << stats.checksum_entries << ",\n";
+		out << "\t\"labels\": " << stats.labels << ",\n";
+		out << "\t\"unresolved_checksums\": " << stats.unresolved_checksums << ",\n";
+		out << "\t\"tokens\": {";
+		bool first = true;
+		for (int i = 0; i < 256; i++)
+		{
+			if (stats.tokens[i] == 0)
+				continue;
+			const char *name = QScript::Stats::TokenName((unsigned char)i);
+			out << (first ? " " : ", ") << "\"" << (name != nullptr ? std::string(name) : std::to_string(i)) << "\": " << stats.tokens[i];
+			first = false;
+		}
+		out << (first ? "}\n" : " }\n");
+		out << "}\n";
+	}
+
+	// Adds one compile's stats to a total, peaks are the largest of any of them
+	// Allocations are counted over every thread, so compiles running at the same time count each other's too
+	inline void Add(QScript::Stats &total, const QScript::Stats &stats)
+	{
+		auto add_allocations = [](QScript::Stats::Allocations &total, const QScript::Stats::Allocations &allocations)
+			{
+				total.count += allocations.count;
+				total.bytes += allocations.bytes;
+				total.peak_bytes = std::max(total.peak_bytes, allocations.peak_bytes);
+			};
+
+		total.lex_seconds += stats.lex_seconds;
+		total.emit_seconds += stats.emit_seconds;
+		total.finish_seconds += stats.finish_seconds;
+		total.label_seconds += stats.label_seconds;
+		total.checksum_seconds += stats.checksum_seconds;
+		total.decompile_seconds += stats.decompile_seconds;
+
+		add_allocations(total.lex_allocations, stats.lex_allocations);
+		add_allocations(total.emit_allocations, stats.emit_allocations);
+		add_allocations(total.finish_allocations, stats.finish_allocations);
+		add_allocations(total.label_allocations, stats.label_allocations);
+		add_allocations(total.checksum_allocations, stats.checksum_allocations);
+		add_allocations(total.decompile_allocations, stats.decompile_allocations);
+
+		total.input_bytes += stats.input_bytes;
+		total.output_bytes += stats.output_bytes;
+		total.source_tokens += stats.source_tokens;
+		total.peak_token_bytes = std::max(total.peak_token_bytes, stats.peak_token_bytes);
+		for (int i = 0; i < 256; i++)
+			total.tokens[i] += stats.tokens[i];
+		total.checksum_entries += stats.checksum_entries;
+		total.labels += stats.labels;
+		total.unresolved_checksums += stats.unresolved_checksums;
+	}
+
+	inline void Write(std::ostream &out, const QScript::Stats &stats, const std::string &format)
+	{
+		if (format == "json")
+			WriteJson(out, stats);
+		else
+			WriteText(out, stats);
+	}
+}
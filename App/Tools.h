@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QScript/QSymbols.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace Tools
+{
+	// Reads in a symbol dictionary, printing why if it can't be read
+	inline bool ReadSymbolsFile(const std::string &path, QScript::Symbols &symbols)
+	{
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			std::cerr << "Failed to open dictionary file" << std::endl;
+			return false;
+		}
+
+		size_t size = file.tellg();
+		std::vector<char> data(size);
+
+		file.seekg(0, std::ios::beg);
+		file.read(data.data(), size);
+
+		try
+		{
+			symbols = QScript::ReadSymbols(data.data(), data.data() + data.size());
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << "Failed to read dictionary file: " << e.what() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Calls visit with every entry under a directory, stopping at the first error
+	template <typename Visit>
+	std::error_code WalkTree(const std::filesystem::path &root, Visit &&visit)
+	{
+		std::error_code error;
+		for (std::filesystem::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+			visit(*it);
+		return error;
+	}
+
+	// Collects every binary under a directory in path order, a file is taken as it is
+	inline bool CollectBinaries(const std::filesystem::path &input, std::vector<std::filesystem::path> &inputs)
+	{
+		if (!std::filesystem::is_directory(input))
+		{
+			inputs.push_back(input);
+			return true;
+		}
+
+		std::error_code error = WalkTree(input, [&inputs](const std::filesystem::directory_entry &entry)
+			{
+				if (entry.is_regular_file() && entry.path().extension() == ".qb")
+					inputs.push_back(entry.path());
+			});
+		if (error)
+		{
+			std::cerr << "Failed to read input directory: " << error.message() << std::endl;
+			return false;
+		}
+		std::sort(inputs.begin(), inputs.end());
+		return true;
+	}
+
+	// Calls work for every index below count on a pool of threads, returning how many threads were used
+	// Each thread makes its own State and passes it to every call, for sessions and buffers that are kept between items
+	template <typename State, typename Work>
+	unsigned int RunPool(size_t count, Work &&work)
+	{
+		unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+		threads = (unsigned int)std::min<size_t>(threads, count);
+
+		std::atomic<size_t> next(0);
+		auto run = [&]()
+			{
+				State state;
+				for (size_t i = next++; i < count; i = next++)
+					work(i, state);
+			};
+
+		std::vector<std::thread> workers;
+		for (unsigned int i = 0; i < threads; i++)
+			workers.emplace_back(run);
+		for (auto &worker : workers)
+			worker.join();
+		return threads;
+	}
+
+	// Writes a string for JSON, control characters are written as spaces
+	inline void WriteJsonString(std::ostream &out, const std::string &string)
+	{
+		out << '"';
+		for (char c : string)
+		{
+			if (c == '"' || c == '\\')
+				out << '\\' << c;
+			else if ((unsigned char)c < 0x20)
+				out << ' ';
+			else
+				out << c;
+		}
+		out << '"';
+	}
+}
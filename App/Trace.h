@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QScript/QTrace.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+namespace Tracing
+{
+	// Starts recording if -trace was given, returns false if tracing isn't built in
+	static bool Start(const std::unordered_map<std::string, std::string> &args)
+	{
+		if (args.find("trace") == args.end())
+			return true;
+		if (!QScript::Trace::available)
+		{
+			std::cerr << "Tracing isn't built in, configure with -DQSCRIPT_TRACE=ON" << std::endl;
+			return false;
+		}
+		QScript::Trace::Start();
+		return true;
+	}
+
+	// Writes out the recorded events if -trace was given
+	static bool Stop(const std::unordered_map<std::string, std::string> &args)
+	{
+		auto find = args.find("trace");
+		if (find == args.end())
+			return true;
+
+		std::ofstream trace_file(find->second);
+		if (!trace_file.is_open() || !QScript::Trace::Stop(trace_file))
+		{
+			std::cerr << "Failed to write trace file" << std::endl;
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <QScript/QCompile.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "Stats.h"
+#include "Tools.h"
+
+namespace Watch
+{
+	using Caches = std::unordered_map<std::string, std::unique_ptr<QScript::CompileCache>>;
+
+	// How scripts are compiled
+	struct Settings
+	{
+		QScript::Target target = QScript::Target::THUG2;
+		QScript::CompileOptions options;
+		std::string stats; // Stats format, the stats of each batch are added up and printed, empty for none
+
+		// Sidecars are written into these trees, mirroring the output tree, empty for none
+		std::filesystem::path symbols_root;
+		std::filesystem::path source_map_root;
+	};
+
+	static bool IsScript(const std::filesystem::path &path)
+	{
+		return path.extension() == ".q";
+	}
+
+	// Writes a file through a temporary file, so it's never seen half written
+	static bool WriteFile(const std::filesystem::path &path, const std::vector<unsigned char> &data)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(path.parent_path(), error);
+
+		std::filesystem::path temp = path;
+		temp += ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary);
+			if (!file.is_open())
+			{
+				std::cerr << "Failed to open output file " << temp.string() << std::endl;
+				return false;
+			}
+			file.write((const char*)data.data(), data.size());
+		}
+
+		std::filesystem::rename(temp, path, error);
+		if (error)
+		{
+			std::cerr << "Failed to write output file " << path.string() << ": " << error.message() << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// Compiles a script, writing its binary and any sidecars
+	static bool CompileFile(const std::filesystem::path &input, const std::filesystem::path &output, const std::filesystem::path &symbols, const std::filesystem::path &source_map, const Settings &settings, QScript::Compiler &compiler, QScript::CompileCache &cache, QScript::Stats *stats)
+	{
+		// Read in file
+		std::ifstream file(input);
+		if (!file.is_open())
+		{
+			std::cerr << "Failed to open input file " << input.string() << std::endl;
+			return false;
+		}
+
+		std::stringstream buffer;
+		buffer << file.rdbuf();
+
+		// Compile
+		QScript::CompileResult out;
+		QScript::CompileOptions options = settings.options;
+		options.source_name = input.string();
+		options.cache = &cache;
+		options.stats = stats;
+		options.strip_checksum_names = !symbols.empty();
+		options.source_map = !source_map.empty();
+		try
+		{
+			compiler.Compile(buffer.str(), settings.target, options, out);
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << "QScript compilation failed: " << input.string() << ": " << e.what() << std::endl;
+			return false;
+		}
+
+		// Write out file
+		if (!WriteFile(output, out.bytecode))
+			return false;
+
+		// Write out sidecars
+		if (!symbols.empty() && !WriteFile(symbols, QScript::WriteSymbols(out.symbols)))
+			return false;
+		if (!source_map.empty() && !WriteFile(source_map, QScript::WriteSourceMap(out.source_map)))
+			return false;
+
+		std::cout << "Compiled " << input.string() << std::endl;
+		return true;
+	}
+
+	// Compiles scripts on a pool of threads, each with its own compiler session
+	// Each compile fills in its own stats, they're added up under a lock as they finish
+	static void CompileBatch(const std::vector<std::filesystem::path> &inputs, const std::filesystem::path &input_root, const std::filesystem::path &output_root, const Settings &settings, Caches &caches)
+	{
+		// Caches are created up front, each one is only used by the thread compiling its script
+		std::vector<QScript::CompileCache*> batch_caches;
+		for (const auto &input : inputs)
+		{
+			auto &cache = caches[input.string()];
+			if (cache == nullptr)
+				cache.reset(new QScript::CompileCache());
+			batch_caches.push_back(cache.get());
+		}
+
+		QScript::Stats total;
+		std::mutex total_mutex;
+
+		Tools::RunPool<QScript::Compiler>(inputs.size(), [&](size_t i, QScript::Compiler &compiler)
+			{
+				std::filesystem::path relative = std::filesystem::relative(inputs[i], input_root);
+				std::filesystem::path output = (output_root / relative).replace_extension(".qb");
+				std::filesystem::path symbols, source_map;
+				if (!settings.symbols_root.empty())
+					symbols = (settings.symbols_root / relative).replace_extension(".qbsym");
+				if (!settings.source_map_root.empty())
+					source_map = (settings.source_map_root / relative).replace_extension(".qbmap");
+
+				QScript::Stats stats;
+				if (CompileFile(inputs[i], output, symbols, source_map, settings, compiler, *batch_caches[i], settings.stats.empty() ? nullptr : &stats))
+				{
+					if (!settings.stats.empty())
+					{
+						std::lock_guard<std::mutex> lock(total_mutex);
+						Stats::Add(total, stats);
+					}
+				}
+			});
+
+		// Print stats
+		if (!settings.stats.empty() && !inputs.empty())
+			Stats::Write(std::cerr, total, settings.stats);
+	}
+
+	// Compiles a source tree into an output tree, then recompiles scripts as they're saved
+	static int Run(const std::string &input, const std::string &output, const Settings &settings)
+	{
+#ifdef __linux__
+		std::filesystem::path input_root(input);
+		std::filesystem::path output_root(output);
+		if (!std::filesystem::is_directory(input_root))
+		{
+			std::cerr << "Watch input must be a directory" << std::endl;
+			return 1;
+		}
+
+		int fd = inotify_init1(IN_CLOEXEC);
+		if (fd < 0)
+		{
+			std::cerr << "Failed to initialize inotify" << std::endl;
+			return 1;
+		}
+
+		// Watch a directory and everything under it, collecting the scripts in it
+		std::unordered_map<int, std::filesystem::path> watches;
+		auto add_tree = [&](const std::filesystem::path &root, std::unordered_set<std::string> &scripts)
+			{
+				auto add_watch = [&](const std::filesystem::path &dir)
+					{
+						int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+						if (wd >= 0)
+							watches[wd] = dir;
+					};
+
+				add_watch(root);
+				Tools::WalkTree(root, [&](const std::filesystem::directory_entry &entry)
+					{
+						if (entry.is_directory())
+							add_watch(entry.path());
+						else if (entry.is_regular_file() && IsScript(entry.path()))
+							scripts.insert(entry.path().string());
+					});
+			};
+
+		// Compile everything to start with
+		Caches caches;
+		std::unordered_set<std::string> changed;
+		add_tree(input_root, changed);
+		CompileBatch(std::vector<std::filesystem::path>(changed.begin(), changed.end()), input_root, output_root, settings, caches);
+		changed.clear();
+
+		std::cout << "Watching " << input_root.string() << std::endl;
+
+		// Collect saves until they settle down, then compile them together
+		static constexpr int DEBOUNCE_MS = 100;
+		alignas(inotify_event) char buffer[4096];
+		while (1)
+		{
+			pollfd poll_fd = { fd, POLLIN, 0 };
+			int ready = poll(&poll_fd, 1, changed.empty() ? -1 : DEBOUNCE_MS);
+			if (ready < 0)
+			{
+				if (errno == EINTR)
+					continue;
+				std::cerr << "Failed to wait for changes" << std::endl;
+				break;
+			}
+
+			if (ready == 0)
+			{
+				CompileBatch(std::vector<std::filesystem::path>(changed.begin(), changed.end()), input_root, output_root, settings, caches);
+				changed.clear();
+				continue;
+			}
+
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+			if (length <= 0)
+				continue;
+
+			for (char *p = buffer; p < buffer + length;)
+			{
+				const inotify_event *event = (const inotify_event*)p;
+				p += sizeof(inotify_event) + event->len;
+
+				// Forget directories that went away
+				if (event->mask & IN_IGNORED)
+				{
+					watches.erase(event->wd);
+					continue;
+				}
+
+				auto find = watches.find(event->wd);
+				if (find == watches.end() || event->len == 0)
+					continue;
+				std::filesystem::path path = find->second / event->name;
+
+				if (event->mask & IN_ISDIR)
+				{
+					// Scripts can land in a new directory before it's watched
+					if (event->mask & (IN_CREATE | IN_MOVED_TO))
+						add_tree(path, changed);
+				}
+				else if (IsScript(path))
+				{
+					if (event->mask & IN_DELETE)
+						caches.erase(path.string());
+					else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+						changed.insert(path.string());
+				}
+			}
+		}
+
+		close(fd);
+		return 1;
+#else
+		(void)input;
+		(void)output;
+		(void)settings;
+		std::cerr << "Watch mode requires inotify" << std::endl;
+		return 1;
+#endif
+	}
+}
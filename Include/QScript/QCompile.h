@@ -1,8 +1,17 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include <QScript/QError.h>
+#include <QScript/QSourceMap.h>
+#include <QScript/QStats.h>
+#include <QScript/QSymbols.h>
+
 namespace QScript
 {
 	// Targets
@@ -12,6 +21,100 @@ namespace QScript
 		THUG2,
 	};
 
+	// Compile cache
+	// Keeps the bytecode of top level definitions and scripts between compiles, so recompiling only compiles the ones that changed
+	struct CompileCacheData;
+
+	struct CompileCache
+	{
+		CompileCache();
+		~CompileCache();
+
+		CompileCache(const CompileCache &) = delete;
+		CompileCache &operator=(const CompileCache &) = delete;
+
+		std::unique_ptr<CompileCacheData> data;
+	};
+
+	// Compile options
+	struct CompileOptions
+	{
+		// Threads jump chains and removes dead branches, unreachable code and empty ELSE blocks
+		bool optimize_branches = false;
+
+		// Leaves ChecksumName records out of the bytecode, the names are returned as symbols instead
+		bool strip_checksum_names = false;
+
+		// Names that are already available to the decompiler, these are never written out
+		const Symbols *shared_symbols = nullptr;
+
+		// Fills in the source map, tagged with the source name
+		bool source_map = false;
+		std::string source_name;
+
+		// Writes EndOfLineNumber in place of EndOfLine tokens
+		bool line_numbers = false;
+
+		// Lexes lines and compiles top level definitions and scripts on several threads, the output is the same as a serial compile
+		bool parallel = false;
+		unsigned int threads = 0; // 0 uses the hardware concurrency
+
+		// Reuses unchanged blocks from earlier compiles with this cache, and fills it in
+		CompileCache *cache = nullptr;
+
+		// Filled in with the time spent in each phase and what was made
+		Stats *stats = nullptr;
+	};
+
+	// Compile result
+	struct CompileResult
+	{
+		std::vector<unsigned char> bytecode;
+		Symbols symbols; // Stripped checksum names
+		SourceMap source_map;
+	};
+
+	// Compiler session
+	// Keeps the lexer, token and bytecode buffers between compiles, so compiling many scripts doesn't reallocate them
+	// Results passed back in keep their buffers too
+	struct CompilerData;
+
+	struct Compiler
+	{
+		Compiler();
+		~Compiler();
+
+		Compiler(const Compiler &) = delete;
+		Compiler &operator=(const Compiler &) = delete;
+
+		void Compile(std::string_view source, const std::vector<Target> &targets, const CompileOptions &options, std::vector<CompileResult> &results);
+		void Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result);
+
+		// Compiles into a caller's buffer, returning the size of the bytecode
+		// The bytecode is written straight from the session's buffers, there's no result in between
+		// Nothing is written if the buffer is too small, the size can be used to retry
+		// Stripped names and the source map are only available through a CompileResult
+		size_t Compile(std::string_view source, Target target, const CompileOptions &options, std::span<std::byte> output);
+
+		// Error code versions, these never throw
+		bool Compile(std::string_view source, const std::vector<Target> &targets, const CompileOptions &options, std::vector<CompileResult> &results, Error &error) noexcept;
+		bool Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result, Error &error) noexcept;
+
+		std::unique_ptr<CompilerData> data;
+	};
+
 	// Compile function
-	std::vector<unsigned char> Compile(const std::string &source, Target target);
+	// Compiling for multiple targets lexes and emits the script once, results are in the same order as the targets
+	// Each call makes a new session and frees it after, use a Compiler to keep the buffers between compiles
+	void Compile(std::string_view source, const std::vector<Target> &targets, const CompileOptions &options, std::vector<CompileResult> &results);
+	void Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result);
+	std::vector<unsigned char> Compile(std::string_view source, Target target, const CompileOptions &options = CompileOptions());
+
+	// Compiles into a caller's buffer, like Compiler::Compile
+	// This uses a session kept by the calling thread, so it holds onto the buffers of the biggest compile until the thread exits
+	size_t Compile(std::string_view source, Target target, const CompileOptions &options, std::span<std::byte> output);
+
+	// Error code version, this never throws
+	// Unlike the other functions, an unrecognized character is an error rather than a printed warning
+	bool Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result, Error &error) noexcept;
 }
@@ -1,9 +1,61 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <span>
 #include <string>
+#include <string_view>
+
+#include <QScript/QError.h>
+#include <QScript/QStats.h>
+#include <QScript/QSymbols.h>
 
 namespace QScript
 {
+	// Decompiler session
+	// Keeps the output and lookup buffers between decompiles, so decompiling many binaries doesn't reallocate them
+	// The returned text is valid until the next decompile
+	struct DecompilerData;
+
+	struct Decompiler
+	{
+		Decompiler();
+		~Decompiler();
+
+		Decompiler(const Decompiler &) = delete;
+		Decompiler &operator=(const Decompiler &) = delete;
+
+		std::string_view Decompile(std::span<const std::byte> binary, const Symbols &symbols = Symbols());
+		std::string_view Decompile(void *start, void *end, const Symbols &symbols = Symbols());
+
+		// Writes straight to the stream instead of the kept output
+		void Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols = Symbols());
+
+		// Fills in the time spent in each phase and what was read
+		void Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Stats &stats);
+
+		// Error code versions, these never throw
+		bool Decompile(std::span<const std::byte> binary, std::string_view &text, const Symbols &symbols, Error &error) noexcept;
+		bool Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Error &error) noexcept;
+
+		std::unique_ptr<DecompilerData> data;
+	};
+
 	// Decompile function
+	// Symbols are used for any checksums that the binary has no name for
+	// The binary is only read, it can be a view of a mapped file
 	std::string Decompile(void *start, void *end);
+	std::string Decompile(void *start, void *end, const Symbols &symbols);
+	std::string Decompile(std::span<const std::byte> binary, const Symbols &symbols = Symbols());
+	void Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols = Symbols());
+	void Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Stats &stats);
+
+	// Error code version, this never throws
+	// The binary is checked before anything is written, so a malformed binary writes nothing
+	bool Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Error &error) noexcept;
+
+	// Binary check
+	// Checks that every token can be read and every RANDOM jump lands inside the binary
+	bool CheckBinary(std::span<const std::byte> binary, Error &error) noexcept;
 }
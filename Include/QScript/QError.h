@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace QScript
+{
+	// Error codes
+	enum class ErrorCode
+	{
+		None,
+
+		// Binary errors, found at a byte offset
+		UnexpectedEndOfFile,
+		UnrecognizedToken,
+		JumpOutOfRange,
+		JumpIntoToken,
+		UnmatchedElse,
+		UnmatchedEndIf,
+		UnmatchedCase,
+		UnmatchedEndSwitch,
+		UnclosedIf,
+		UnclosedSwitch,
+		BadRandom,
+		DataAfterEndOfFile,
+
+		// Source errors, found at a line and column
+		UnrecognizedCharacter,
+		UnexpectedEndOfScript,
+		ExpectedNumber,
+		ExpectedOpenParenth,
+		ExpectedComma,
+		ExpectedCloseParenth,
+		ExpectedCommaOrCloseParenth,
+		UnexpectedEndSwitch,
+		UnexpectedCase,
+		UnexpectedElse,
+		UnexpectedEndIf,
+		UnexpectedRandomCase,
+		TooManyRandomCases,
+		UnexpectedRandomEnd,
+		IncompleteRandom,
+		MissingEndSwitch,
+		MissingRandomEnd,
+		MissingEndIf,
+		ChecksumCollision,
+
+		// Anything else, such as running out of memory
+		Internal,
+	};
+
+	// Error report
+	// Reporting an error doesn't build any strings, the message is only made when asked for
+	struct Error
+	{
+		ErrorCode code = ErrorCode::None;
+
+		size_t offset = 0; // Byte offset of a binary error
+		int line = 0, column = 0; // Source location of a source error
+		unsigned char value = 0; // Unrecognized token or character
+		uint32_t checksum = 0; // Colliding checksum
+
+		std::string detail; // Colliding names, or the message of an internal error
+
+		explicit operator bool() const noexcept { return code != ErrorCode::None; }
+
+		// Fixed description of the code
+		const char *Description() const noexcept;
+
+		// Description with where the error was found
+		std::string Message() const;
+	};
+}
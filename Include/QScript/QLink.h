@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+#include <QScript/QCompile.h>
+
+namespace QScript
+{
+	// Link function
+	// Joins compiled units into one bytecode, in order, with a single checksum name table
+	// Stripped symbols and source maps are merged along with the bytecode
+	// An end of line is put between units where one doesn't end its last line
+	void Link(const std::vector<CompileResult> &units, CompileResult &result);
+}
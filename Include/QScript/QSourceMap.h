@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace QScript
+{
+	// Source location of a bytecode offset
+	struct SourceMapEntry
+	{
+		uint32_t offset = 0;
+		uint32_t file = 0;
+		uint32_t line = 0;
+		uint32_t column = 0;
+	};
+
+	// Bytecode offset to source location table
+	struct SourceMap
+	{
+		std::vector<std::string> files;
+		std::vector<SourceMapEntry> entries; // Sorted by offset
+
+		// Finds the entry covering an offset
+		const SourceMapEntry *Find(uint32_t offset) const;
+	};
+
+	// Source map sidecar functions
+	std::vector<unsigned char> WriteSourceMap(const SourceMap &source_map);
+	SourceMap ReadSourceMap(const void *start, const void *end);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+
+namespace QScript
+{
+	// Compile and decompile statistics
+	// Filled in when asked for, everything is reset at the start of each compile or decompile
+	struct Stats
+	{
+		// Heap use of a phase, counted over every thread
+		// Only counted in builds with QSCRIPT_ALLOC_STATS, which replace the global operator new and delete
+		struct Allocations
+		{
+			size_t count = 0;
+			size_t bytes = 0;
+			size_t peak_bytes = 0; // Most held at once, above what was held when the phase started
+		};
+
+	#ifdef QSCRIPT_ALLOC_STATS
+		static constexpr bool allocations_counted = true;
+	#else
+		static constexpr bool allocations_counted = false;
+	#endif
+
+		// Time spent in each phase, in seconds
+		double lex_seconds = 0.0;
+		double emit_seconds = 0.0; // Compiles through a cache count their lexing here
+		double finish_seconds = 0.0; // Fixing up jumps, optimizing and writing out checksum names
+		double label_seconds = 0.0;
+		double checksum_seconds = 0.0; // Collecting checksum names from the binary and symbols
+		double decompile_seconds = 0.0; // Writing out text
+
+		Allocations lex_allocations;
+		Allocations emit_allocations;
+		Allocations finish_allocations;
+		Allocations label_allocations;
+		Allocations checksum_allocations;
+		Allocations decompile_allocations;
+
+		size_t input_bytes = 0;
+		size_t output_bytes = 0; // Summed over targets
+
+		size_t source_tokens = 0; // Tokens out of the lexer, not counted for compiles through a cache
+		size_t peak_token_bytes = 0; // Memory held by lexer tokens
+		size_t tokens[256] = {}; // Bytecode tokens by type, written or read, summed over targets
+		size_t checksum_entries = 0; // ChecksumName records written or read
+		size_t labels = 0;
+		size_t unresolved_checksums = 0; // Checksums without a name, written as raw checksums
+
+		// Name of a bytecode token type, or null if there's no such type
+		static const char *TokenName(unsigned char token);
+	};
+}
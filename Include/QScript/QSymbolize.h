@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include <QScript/QError.h>
+#include <QScript/QSymbols.h>
+
+namespace QScript
+{
+	// Symbolized bytecode offset
+	struct Symbol
+	{
+		bool valid = false; // False when the offset is outside of the binary
+		bool in_definition = false; // False for line ends and checksum names between definitions
+
+		// Definition holding the offset
+		std::string_view name; // Empty if neither the binary nor the symbols have a name for it
+		uint32_t checksum = 0;
+		bool is_script = false;
+		size_t start = 0;
+		size_t relative = 0; // Offset from the start of the definition
+
+		// Token holding the offset
+		size_t token = 0;
+		unsigned char type = 0;
+		size_t line = 0; // Line of the token in the decompiled text, from 1
+	};
+
+	// Symbolizer
+	// Indexes a binary's definitions and tokens once, then maps offsets to them with binary searches
+	// Names are copied, so the binary doesn't have to outlive the symbolizer
+	struct SymbolizerData;
+
+	struct Symbolizer
+	{
+		Symbolizer();
+		~Symbolizer();
+
+		Symbolizer(const Symbolizer &) = delete;
+		Symbolizer &operator=(const Symbolizer &) = delete;
+
+		// Symbols are used for any checksums that the binary has no name for
+		bool Load(std::span<const std::byte> binary, const Symbols &symbols, Error &error) noexcept;
+
+		// Only valid after a successful load, names point into the symbolizer until the next load
+		Symbol Symbolize(size_t offset) const noexcept;
+		void Symbolize(std::span<const size_t> offsets, std::span<Symbol> symbols) const noexcept;
+
+		std::unique_ptr<SymbolizerData> data;
+	};
+}
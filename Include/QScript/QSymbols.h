@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace QScript
+{
+	// Checksum to name table
+	using Symbols = std::unordered_map<uint32_t, std::string>;
+
+	// Symbol sidecar functions
+	// A sidecar holds ChecksumName records terminated by EndOfFile, the same layout as the end of a qb
+	std::vector<unsigned char> WriteSymbols(const Symbols &symbols);
+	Symbols ReadSymbols(void *start, void *end);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace QScript
+{
+	// Trace events
+	// Built in when QSCRIPT_TRACE is defined, otherwise starting and stopping do nothing and scopes compile away
+	// Scopes on every thread are recorded between Start and Stop, then written out as Chrome trace-event JSON,
+	// which chrome://tracing and Perfetto can open
+	namespace Trace
+	{
+	#ifdef QSCRIPT_TRACE
+		static constexpr bool available = true;
+
+		void Start();
+
+		// Stops recording and writes out the events, returns false if writing failed
+		bool Stop(std::ostream &out);
+
+		// Records the time between construction and destruction as one event
+		// The name must outlive the trace, the detail is copied
+		class Scope
+		{
+			private:
+				const char *name;
+				std::string detail;
+				int64_t start;
+
+			public:
+				Scope(const char *_name);
+				Scope(const char *_name, std::string_view _detail);
+				~Scope();
+
+				Scope(const Scope &) = delete;
+				Scope &operator=(const Scope &) = delete;
+		};
+
+		#define QSCRIPT_TRACE_JOIN2(a, b) a##b
+		#define QSCRIPT_TRACE_JOIN(a, b) QSCRIPT_TRACE_JOIN2(a, b)
+		#define QSCRIPT_TRACE_SCOPE(...) QScript::Trace::Scope QSCRIPT_TRACE_JOIN(qscript_trace_scope_, __LINE__)(__VA_ARGS__)
+	#else
+		static constexpr bool available = false;
+
+		inline void Start() {}
+		inline bool Stop(std::ostream &) { return true; }
+
+		// Arguments aren't evaluated
+		#define QSCRIPT_TRACE_SCOPE(...) ((void)0)
+	#endif
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+
+#include <QScript/QError.h>
+
+namespace QScript
+{
+	// Verifier session
+	// Keeps the token map and block stack between binaries, so verifying many binaries doesn't reallocate them
+	struct VerifierData;
+
+	struct Verifier
+	{
+		Verifier();
+		~Verifier();
+
+		Verifier(const Verifier &) = delete;
+		Verifier &operator=(const Verifier &) = delete;
+
+		bool Verify(std::span<const std::byte> binary, Error &error) noexcept;
+
+		std::unique_ptr<VerifierData> data;
+	};
+
+	// Verify function
+	// Checks that every token can be read, every jump lands on the start of a token, IF/ELSE/ENDIF and SWITCH/CASE/ENDSWITCH nest,
+	// RANDOM jump tables are consistent and the binary ends with EndOfFile
+	// The first problem found is reported with its byte offset
+	bool Verify(std::span<const std::byte> binary, Error &error) noexcept;
+}
@@ -0,0 +1,105 @@
+#include "QAlloc.h"
+
+#ifdef QSCRIPT_ALLOC_STATS
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Replacement operator new and delete, counting every allocation in the program
+// Each block is preceded by a header holding its size and the pointer malloc returned, so deletes can be counted too
+// The library calls the counters, which pulls this file and its replacements into any program linking it
+namespace QScript
+{
+	static std::atomic<size_t> alloc_count(0);
+	static std::atomic<size_t> alloc_bytes(0);
+	static std::atomic<size_t> alloc_current(0);
+	static std::atomic<size_t> alloc_peak(0);
+
+	struct AllocHeader
+	{
+		void *base;
+		size_t size;
+	};
+
+	static void *Allocate(size_t size, size_t alignment) noexcept
+	{
+		if (alignment < alignof(AllocHeader))
+			alignment = alignof(AllocHeader);
+
+		void *base = std::malloc(size + sizeof(AllocHeader) + alignment);
+		if (base == nullptr)
+			return nullptr;
+
+		uintptr_t address = ((uintptr_t)base + sizeof(AllocHeader) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+		AllocHeader *header = (AllocHeader *)address - 1;
+		header->base = base;
+		header->size = size;
+
+		alloc_count.fetch_add(1, std::memory_order_relaxed);
+		alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+		size_t current = alloc_current.fetch_add(size, std::memory_order_relaxed) + size;
+		size_t peak = alloc_peak.load(std::memory_order_relaxed);
+		while (current > peak && !alloc_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed));
+
+		return (void *)address;
+	}
+
+	static void Free(void *pointer) noexcept
+	{
+		if (pointer == nullptr)
+			return;
+
+		AllocHeader *header = (AllocHeader *)pointer - 1;
+		alloc_current.fetch_sub(header->size, std::memory_order_relaxed);
+		std::free(header->base);
+	}
+
+	static void *AllocateOrThrow(size_t size, size_t alignment)
+	{
+		void *pointer = Allocate(size, alignment);
+		if (pointer == nullptr)
+			throw std::bad_alloc();
+		return pointer;
+	}
+
+	AllocCounters GetAllocCounters()
+	{
+		AllocCounters counters;
+		counters.count = alloc_count.load(std::memory_order_relaxed);
+		counters.bytes = alloc_bytes.load(std::memory_order_relaxed);
+		counters.current = alloc_current.load(std::memory_order_relaxed);
+		counters.peak = alloc_peak.load(std::memory_order_relaxed);
+		return counters;
+	}
+
+	void ResetAllocPeak()
+	{
+		alloc_peak.store(alloc_current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+void *operator new(size_t size) { return QScript::AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new[](size_t size) { return QScript::AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new(size_t size, std::align_val_t alignment) { return QScript::AllocateOrThrow(size, (size_t)alignment); }
+void *operator new[](size_t size, std::align_val_t alignment) { return QScript::AllocateOrThrow(size, (size_t)alignment); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return QScript::Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return QScript::Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__); }
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return QScript::Allocate(size, (size_t)alignment); }
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept { return QScript::Allocate(size, (size_t)alignment); }
+
+void operator delete(void *pointer) noexcept { QScript::Free(pointer); }
+void operator delete[](void *pointer) noexcept { QScript::Free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { QScript::Free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { QScript::Free(pointer); }
+void operator delete(void *pointer, std::align_val_t) noexcept { QScript::Free(pointer); }
+void operator delete[](void *pointer, std::align_val_t) noexcept { QScript::Free(pointer); }
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept { QScript::Free(pointer); }
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept { QScript::Free(pointer); }
+void operator delete(void *pointer, const std::nothrow_t &) noexcept { QScript::Free(pointer); }
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept { QScript::Free(pointer); }
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { QScript::Free(pointer); }
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept { QScript::Free(pointer); }
+
+#endif
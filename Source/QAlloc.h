@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include <QScript/QStats.h>
+
+namespace QScript
+{
+	// Allocation counters
+	// Kept by the replacement operator new and delete in builds with QSCRIPT_ALLOC_STATS, otherwise always zero
+	struct AllocCounters
+	{
+		size_t count = 0;
+		size_t bytes = 0;
+		size_t current = 0; // Bytes held now
+		size_t peak = 0; // Most bytes held since the peak was last reset
+	};
+
+#ifdef QSCRIPT_ALLOC_STATS
+	AllocCounters GetAllocCounters();
+	void ResetAllocPeak();
+#else
+	inline AllocCounters GetAllocCounters() { return AllocCounters(); }
+	inline void ResetAllocPeak() {}
+#endif
+
+	// Times the phases of a compile or decompile into stats, each lap ends one phase and starts the next
+	class PhaseTimer
+	{
+		private:
+			using Clock = std::chrono::steady_clock;
+
+			Clock::time_point start;
+			AllocCounters alloc_start;
+
+		public:
+			PhaseTimer()
+			{
+				ResetAllocPeak();
+				alloc_start = GetAllocCounters();
+				start = Clock::now();
+			}
+
+			void Lap(double &seconds, Stats::Allocations &allocations)
+			{
+				auto now = Clock::now();
+				seconds += std::chrono::duration<double>(now - start).count();
+
+				AllocCounters alloc_now = GetAllocCounters();
+				allocations.count += alloc_now.count - alloc_start.count;
+				allocations.bytes += alloc_now.bytes - alloc_start.bytes;
+				if (alloc_now.peak > alloc_start.current && alloc_now.peak - alloc_start.current > allocations.peak_bytes)
+					allocations.peak_bytes = alloc_now.peak - alloc_start.current;
+
+				ResetAllocPeak();
+				alloc_start = GetAllocCounters();
+				start = Clock::now();
+			}
+	};
+}
@@ -1,17 +1,32 @@
 #include "QBinary.h"
 
+#include <QScript/QTrace.h>
+
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <string>
 
 namespace QScript
 {
-	char *SkipToken(char *p_start, char *p_end, char *p_token)
+	char *SkipToken(char *p_start, char *p_end, char *p_token, Error &error) noexcept
 	{
-		if (p_token < p_start)
-			throw std::runtime_error("[SkipToken] Unexpected start of file");
-		if (p_token >= p_end)
-			throw std::runtime_error("[SkipToken] Unexpected end of file");
+		auto fail = [&](ErrorCode code) -> char *
+			{
+				error.code = code;
+				error.offset = p_token - p_start;
+				error.value = (p_token >= p_start && p_token < p_end) ? (unsigned char)*p_token : 0;
+				return nullptr;
+			};
+		auto read_length = [&](char *p) -> uint32_t
+			{
+				return (uint32_t)(unsigned char)p[0] | ((uint32_t)(unsigned char)p[1] << 8) | ((uint32_t)(unsigned char)p[2] << 16) | ((uint32_t)(unsigned char)p[3] << 24);
+			};
+
+		if (p_token < p_start || p_token >= p_end)
+			return fail(ErrorCode::UnexpectedEndOfFile);
+
+		size_t size = 0;
 
 		switch ((Token)*p_token)
 		{
@@ -66,7 +81,7 @@ namespace QScript
 			case Token::KeywordDefault:
 			case Token::Colon:
 			{
-				p_token++;
+				size = 1;
 				break;
 			}
 			case Token::Name:
@@ -78,38 +93,38 @@ namespace QScript
 			// case Token::RuntimeMemberFunction:
 			// case Token::RuntimeCFunction:
 			{
-				p_token += 5;
+				size = 5;
 				break;
 			}
 			case Token::Vector:
 			{
-				p_token += 13;
+				size = 13;
 				break;
 			}
 			case Token::Pair:
 			{
-				p_token += 9;
+				size = 9;
 				break;
 			}
 			case Token::String:
 			case Token::LocalString:
 			{
-				p_token++;
-
-				uint32_t num_bytes = GetUnsignedInteger(p_start, p_end, p_token);
-				p_token += 4;
-				p_token += num_bytes;
+				if (p_end - p_token < 5)
+					return fail(ErrorCode::UnexpectedEndOfFile);
+				size = 5 + (size_t)read_length(p_token + 1);
 				break;
 			}
 			case Token::ChecksumName:
 			{
 				// Skip over the token and checksum.
-				p_token += 5;
+				size = 5;
 
 				// Skip over the string.
-				while (*p_token != '\0')
-					p_token++;
-				p_token++;
+				while (size < (size_t)(p_end - p_token) && p_token[size] != '\0')
+					size++;
+				if (size >= (size_t)(p_end - p_token))
+					return fail(ErrorCode::UnexpectedEndOfFile);
+				size++;
 				break;
 			}
 			case Token::KeywordRandom:
@@ -117,29 +132,78 @@ namespace QScript
 			case Token::KeywordRandomNoRepeat:
 			case Token::KeywordRandomPermute:
 			{
-				p_token++;
-
-				uint32_t num_jumps = GetUnsignedInteger(p_start, p_end, p_token);
-				p_token += 4;
+				if (p_end - p_token < 5)
+					return fail(ErrorCode::UnexpectedEndOfFile);
 
 				// Skip over all the weight & jump offsets.
-				p_token += 2 * num_jumps + 4 * num_jumps;
+				size = 5 + 6 * (size_t)read_length(p_token + 1);
 				break;
 			}
 			case Token::FastIf:
 			case Token::FastElse:
 			case Token::ShortJump:
 			{
-				p_token += 3;
+				size = 3;
 				break;
 			}
 			default:
 			{
-				throw std::runtime_error("[SkipToken] Unrecognized script token " + std::to_string((int)(unsigned char)*p_token) + " at " + std::to_string((int)(p_token - p_start)));
-				break;
+				return fail(ErrorCode::UnrecognizedToken);
+			}
+		}
+
+		// The whole token has to be in the file
+		if ((size_t)(p_end - p_token) < size)
+			return fail(ErrorCode::UnexpectedEndOfFile);
+		return p_token + size;
+	}
+
+	char *SkipToken(char *p_start, char *p_end, char *p_token)
+	{
+		Error error;
+		char *p_next = SkipToken(p_start, p_end, p_token, error);
+		if (error)
+			throw std::runtime_error("[SkipToken] " + error.Message());
+		return p_next;
+	}
+
+	bool CheckBinary(char *p_start, char *p_end, Error &error) noexcept
+	{
+		char *p_token = p_start;
+		while (p_token != nullptr)
+		{
+			char *p_next = SkipToken(p_start, p_end, p_token, error);
+			if (error)
+				return false;
+
+			// RANDOM jumps are followed to find the jump at the end of each case
+			switch ((Token)*p_token)
+			{
+				case Token::KeywordRandom:
+				case Token::KeywordRandom2:
+				case Token::KeywordRandomNoRepeat:
+				case Token::KeywordRandomPermute:
+				{
+					uint32_t num_jumps = GetUnsignedInteger(p_start, p_end, p_token + 1);
+					for (uint32_t i = 1; i < num_jumps; i++)
+					{
+						ptrdiff_t address = GetAddress_Relative(p_start, p_end, p_token + 5 + 2 * num_jumps + 4 * i);
+						if (address - 5 < 0 || address - 5 >= p_end - p_start)
+						{
+							error.code = ErrorCode::JumpOutOfRange;
+							error.offset = p_token - p_start;
+							error.value = (unsigned char)*p_token;
+							return false;
+						}
+					}
+					break;
+				}
+				default:
+					break;
 			}
+			p_token = p_next;
 		}
-		return p_token;
+		return true;
 	}
 
 	int32_t GetSignedInteger(char *p_start, char *p_end, char *p_token)
@@ -213,9 +277,22 @@ namespace QScript
 		return (p_token + address) - p_start;
 	}
 
-	std::unordered_map<ptrdiff_t, std::string> GetLabels(char *p_start, char *p_end, char *p_token)
+	void GetLabels(char *p_start, char *p_end, char *p_token, std::vector<std::pair<ptrdiff_t, std::string_view>> &labels)
 	{
-		std::unordered_map<ptrdiff_t, std::string> labels;
+		QSCRIPT_TRACE_SCOPE("GetLabels");
+
+		// Labels are kept sorted as they're found, they mostly come in order
+		// Later labels at the same address replace earlier ones
+		labels.clear();
+		auto set_label = [&labels](ptrdiff_t address, std::string_view label)
+			{
+				auto it = std::lower_bound(labels.begin(), labels.end(), address, [](const std::pair<ptrdiff_t, std::string_view> &a, ptrdiff_t b) { return a.first < b; });
+				if (it != labels.end() && it->first == address)
+					it->second = label;
+				else
+					labels.emplace(it, address, label);
+			};
+
 		while (p_token != nullptr)
 		{
 			char *p_base = SkipToken(p_start, p_end, p_token);
@@ -243,7 +320,7 @@ namespace QScript
 					if (num_jumps == 0)
 					{
 						ptrdiff_t address = (p_token + 5) - p_start;
-						labels[address] = "RANDOMEND";
+						set_label(address, "RANDOMEND");
 						break;
 					}
 					for (uint32_t i = 0; i < num_jumps; i++)
@@ -251,9 +328,9 @@ namespace QScript
 						uint16_t weight = GetUnsignedShort(p_start, p_end, p_token + 5 + i * 2);
 						ptrdiff_t address = GetAddress_Relative(p_start, p_end, p_token + 5 + 2 * num_jumps + 4 * i);
 						if (num_jumps == 1)
-							labels[address] = "RANDOMCASE RANDOMEND";
+							set_label(address, "RANDOMCASE RANDOMEND");
 						else
-							labels[address] = "RANDOMCASE";
+							set_label(address, "RANDOMCASE");
 
 						if (i > 0)
 						{
@@ -264,7 +341,7 @@ namespace QScript
 							if ((Token)*p == Token::Jump)
 							{
 								ptrdiff_t jump_address = GetAddress_Relative(p_start, p_end, p + 1);
-								labels[jump_address] = "RANDOMEND";
+								set_label(jump_address, "RANDOMEND");
 							}
 						}
 					}
@@ -277,35 +354,141 @@ namespace QScript
 			// Skip over the token
 			p_token = p_base;
 		}
+	}
+
+	std::unordered_map<ptrdiff_t, std::string> GetLabels(char *p_start, char *p_end, char *p_token)
+	{
+		std::vector<std::pair<ptrdiff_t, std::string_view>> found;
+		GetLabels(p_start, p_end, p_token, found);
+
+		std::unordered_map<ptrdiff_t, std::string> labels;
+		for (const auto &label : found)
+			labels.emplace(label.first, label.second);
 		return labels;
 	}
 
-	std::unordered_map<uint32_t, std::string> GetChecksumStrings(char *p_start, char *p_end, char *p_token)
+	void GetChecksumStrings(char *p_start, char *p_end, char *p_token, std::vector<std::pair<uint32_t, std::string_view>> &checksum_strings)
 	{
-		std::unordered_map<uint32_t, std::string> checksum_strings;
+		QSCRIPT_TRACE_SCOPE("GetChecksumStrings");
+
+		checksum_strings.clear();
 		while (p_token != nullptr)
 		{
 			// Check if this is a checksum name token
 			if ((Token)*p_token == Token::ChecksumName)
 			{
-				// Get checksum and name
-				unsigned long checksum = GetUnsignedInteger(p_start, p_end, p_token + 1);
-				std::string name;
-				char *name_p = p_token + 5;
-				while (*name_p)
-				{
-					name += *name_p;
-					++name_p;
-				}
-
-				// Add to map
-				// std::cout << "Found checksum " << checksum << " for name " << name << std::endl;
-				checksum_strings[checksum] = name;
+				// Get checksum and name, the name is left in the binary
+				uint32_t checksum = GetUnsignedInteger(p_start, p_end, p_token + 1);
+				checksum_strings.emplace_back(checksum, std::string_view(p_token + 5));
 			}
 
 			// Skip over the token
 			p_token = SkipToken(p_start, p_end, p_token);
 		}
+
+		// Sort by checksum, names come in file order so the last name for a checksum is the one furthest in
+		std::sort(checksum_strings.begin(), checksum_strings.end(), [](const std::pair<uint32_t, std::string_view> &a, const std::pair<uint32_t, std::string_view> &b)
+			{
+				if (a.first != b.first)
+					return a.first < b.first;
+				return a.second.data() < b.second.data();
+			});
+
+		size_t kept = 0;
+		for (size_t i = 0; i < checksum_strings.size(); i++)
+		{
+			if (i + 1 == checksum_strings.size() || checksum_strings[i + 1].first != checksum_strings[i].first)
+				checksum_strings[kept++] = checksum_strings[i];
+		}
+		checksum_strings.resize(kept);
+	}
+
+	std::unordered_map<uint32_t, std::string> GetChecksumStrings(char *p_start, char *p_end, char *p_token)
+	{
+		std::vector<std::pair<uint32_t, std::string_view>> found;
+		GetChecksumStrings(p_start, p_end, p_token, found);
+
+		std::unordered_map<uint32_t, std::string> checksum_strings;
+		for (const auto &checksum_string : found)
+			checksum_strings.emplace(checksum_string.first, checksum_string.second);
 		return checksum_strings;
 	}
+
+	void GetDefinitions(char *p_start, char *p_end, std::vector<Definition> &definitions)
+	{
+		definitions.clear();
+
+		Definition *definition = nullptr;
+		int depth = 0;
+		for (char *p_token = p_start; p_token != nullptr;)
+		{
+			char *p_next = SkipToken(p_start, p_end, p_token);
+			Token token = (Token)*p_token;
+
+			// Start a definition at anything but line ends and the checksum table
+			if (definition == nullptr)
+			{
+				switch (token)
+				{
+					case Token::EndOfFile:
+					case Token::EndOfLine:
+					case Token::EndOfLineNumber:
+					case Token::ChecksumName:
+						p_token = p_next;
+						continue;
+					default:
+						break;
+				}
+
+				definition = &definitions.emplace_back();
+				definition->start = p_token - p_start;
+				definition->is_script = token == Token::KeywordScript;
+				depth = 0;
+
+				// Named by its first name
+				char *p_name = definition->is_script ? p_next : p_token;
+				if (p_name != nullptr && p_name < p_end && (Token)*p_name == Token::Name)
+				{
+					definition->checksum = GetUnsignedInteger(p_start, p_end, p_name + 1);
+					definition->named = true;
+				}
+			}
+
+			switch (token)
+			{
+				case Token::EndOfFile:
+					definition->end = p_token - p_start;
+					definition = nullptr;
+					break;
+				case Token::EndOfLine:
+				case Token::EndOfLineNumber:
+					if (!definition->is_script && depth == 0)
+					{
+						definition->end = p_token - p_start;
+						definition = nullptr;
+					}
+					break;
+				case Token::KeywordEndScript:
+					if (definition->is_script)
+					{
+						definition->end = p_next - p_start;
+						definition = nullptr;
+					}
+					break;
+				case Token::StartStruct:
+				case Token::StartArray:
+				case Token::OpenParenth:
+					depth++;
+					break;
+				case Token::EndStruct:
+				case Token::EndArray:
+				case Token::CloseParenth:
+					depth--;
+					break;
+				default:
+					break;
+			}
+			p_token = p_next;
+		}
+	}
 }
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <unordered_map>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <QScript/QError.h>
+#include <QScript/QStats.h>
 
 #include "QToken.h"
 
@@ -10,6 +18,15 @@ namespace QScript
 	// Binary processing functions
 	char *SkipToken(char *p_start, char *p_end, char *p_token);
 
+	// Returns null at the end of the file and on errors, which are reported instead of thrown
+	char *SkipToken(char *p_start, char *p_end, char *p_token, Error &error) noexcept;
+
+	// Checks every token and RANDOM jump, so that reading the binary can't fail
+	bool CheckBinary(char *p_start, char *p_end, Error &error) noexcept;
+
+	// Adds the tokens and ChecksumName records of a binary to the stats, stopping at the first unreadable token
+	void CountTokens(char *p_start, char *p_end, Stats &stats);
+
 	int32_t GetSignedInteger(char *p_start, char *p_end, char *p_token);
 	uint32_t GetUnsignedInteger(char *p_start, char *p_end, char *p_token);
 	int16_t GetSignedShort(char *p_start, char *p_end, char *p_token);
@@ -20,4 +37,22 @@ namespace QScript
 
 	std::unordered_map<ptrdiff_t, std::string> GetLabels(char *p_start, char *p_end, char *p_token);
 	std::unordered_map<uint32_t, std::string> GetChecksumStrings(char *p_start, char *p_end, char *p_token);
+
+	// Sorted by address or checksum, for lookups with std::lower_bound
+	// Names point into the binary, which has to outlive them
+	void GetLabels(char *p_start, char *p_end, char *p_token, std::vector<std::pair<ptrdiff_t, std::string_view>> &labels);
+	void GetChecksumStrings(char *p_start, char *p_end, char *p_token, std::vector<std::pair<uint32_t, std::string_view>> &checksum_strings);
+
+	// Top level SCRIPT or global definition
+	// Scripts run up to and including their ENDSCRIPT, globals up to the first line end outside of any struct, array or parentheses
+	struct Definition
+	{
+		size_t start = 0, end = 0;
+		uint32_t checksum = 0; // Checksum of the first name, if it has one
+		bool named = false;
+		bool is_script = false;
+	};
+
+	// Finds the definitions of a binary in file order
+	void GetDefinitions(char *p_start, char *p_end, std::vector<Definition> &definitions);
 }
@@ -1,16 +1,23 @@
 #include <QScript/QCompile.h>
+#include <QScript/QTrace.h>
 
-#define YY_NO_UNISTD_H
-#include <Lexical/Lexical.h>
-
+#include "QAlloc.h"
+#include "QBinary.h"
 #include "QLexer.h"
+#include "QOptimize.h"
+#include "QProbes.h"
+#include "QRewrite.h"
 #include "QUtil.h"
 
 #include <iostream>
+#include <algorithm>
+#include <cctype>
 #include <cmath>
+#include <cstring>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
-#include <stack>
+#include <unordered_set>
 
 namespace QScript
 {
@@ -31,19 +38,297 @@ namespace QScript
 		},
 	};
 
-	// Compile function
-	std::vector<unsigned char> Compile(const std::string &source, Target target)
+	// Short jump of an IF or SWITCH block
+	struct ShortJump
 	{
-		// Get target properties
-		const auto &target_props = s_target_props[(int)target];
+		size_t address = 0; // Address of the FastIf, FastElse or ShortJump token
+		size_t target = 0;
+		size_t block = 0;
+	};
 
-		// Perform lexical analysis
-		qscript_lex__scan_string(source.c_str());
-		while (qscript_lex_lex()) {}
-		qscript_lex_lex_destroy();
+	static constexpr size_t NO_BLOCK = (size_t)-1;
 
-		// Process tokens
+	// Lowers IF and SWITCH blocks to their long form, which doesn't use short jumps
+	static void LowerBlocks(std::vector<unsigned char> &bytecode, std::vector<ShortJump> &short_jumps, const std::vector<bool> &lower, std::vector<size_t> *addresses)
+	{
+		std::vector<Edit> edits;
+		std::vector<Relocation> relocations;
+		std::vector<ShortJump> kept;
+
+		for (const auto &jump : short_jumps)
+		{
+			if (lower[jump.block])
+			{
+				switch ((Token)bytecode[jump.address])
+				{
+					case Token::FastIf:
+						edits.push_back(Edit{ jump.address, 3, { (unsigned char)Token::KeywordIf } });
+						break;
+					case Token::FastElse:
+						edits.push_back(Edit{ jump.address, 3, { (unsigned char)Token::KeywordElse } });
+						break;
+					default:
+						edits.push_back(Edit{ jump.address, 3, {} });
+						break;
+				}
+			}
+			else
+			{
+				kept.push_back(jump);
+				relocations.push_back(Relocation{ jump.address + 1, jump.target, true });
+			}
+		}
+
+		// Short jumps are taken from the blocks, since their encoded offsets may have been truncated
+		for (const auto &relocation : GetRelocations(bytecode, GetTokenAddresses(bytecode, 0, bytecode.size())))
+		{
+			if (!relocation.is_short)
+				relocations.push_back(relocation);
+		}
+
+		ApplyEdits(bytecode, relocations, std::move(edits), addresses);
+
+		for (size_t i = 0; i < kept.size(); i++)
+		{
+			kept[i].address = relocations[i].field - 1;
+			kept[i].target = relocations[i].target;
+		}
+		short_jumps = std::move(kept);
+	}
+
+	// Lowers blocks whose short jumps are out of range, along with any blocks nested inside of them
+	// lower is scratch space for the blocks being lowered
+	static void RelaxBlocks(std::vector<unsigned char> &bytecode, std::vector<ShortJump> &short_jumps, const std::vector<size_t> &block_parents, std::vector<bool> &lower, std::vector<size_t> *addresses)
+	{
+		while (1)
+		{
+			lower.assign(block_parents.size(), false);
+			bool relax = false;
+			for (const auto &jump : short_jumps)
+			{
+				ptrdiff_t relative = (ptrdiff_t)jump.target - (ptrdiff_t)(jump.address + 1);
+				if (relative < -0x8000 || relative > 0x7FFF)
+					lower[jump.block] = relax = true;
+			}
+			if (!relax)
+				break;
+
+			// Parents always come before their children
+			for (size_t i = 0; i < block_parents.size(); i++)
+			{
+				if (block_parents[i] != NO_BLOCK && lower[block_parents[i]])
+					lower[i] = true;
+			}
+
+			LowerBlocks(bytecode, short_jumps, lower, addresses);
+		}
+	}
+
+	// Gets the names referenced by bytecode
+	static std::unordered_set<unsigned long> GetUsedChecksums(std::vector<unsigned char> &bytecode)
+	{
+		std::unordered_set<unsigned long> used;
+		for (const auto &address : GetTokenAddresses(bytecode, 0, bytecode.size()))
+		{
+			if ((Token)bytecode[address] == Token::Name)
+				used.insert(bytecode[address + 1] | (bytecode[address + 2] << 8) | (bytecode[address + 3] << 16) | ((unsigned long)bytecode[address + 4] << 24));
+		}
+		return used;
+	}
+
+	// Builds a source map from the locations and where their code ended up
+	// Where code was removed, the location of the code that took its place wins
+	static void BuildSourceMap(SourceMap &source_map, const std::string &source_name, const std::vector<SourceMapEntry> &locations, const std::vector<size_t> &location_offsets)
+	{
+		source_map.files.push_back(source_name);
+		for (size_t i = 0; i < locations.size(); i++)
+		{
+			SourceMapEntry entry = locations[i];
+			entry.offset = (uint32_t)location_offsets[i];
+			if (!source_map.entries.empty() && source_map.entries.back().offset == entry.offset)
+				source_map.entries.back() = entry;
+			else
+				source_map.entries.push_back(entry);
+		}
+	}
+
+	// Checksum names in order of first use
+	// Names are packed into one buffer and found through an open addressed table, so clearing keeps all of their storage
+	class ChecksumNames
+	{
+		private:
+			struct Entry
+			{
+				unsigned long crc;
+				size_t offset, length; // Name in the text, followed by a null
+			};
+			std::vector<Entry> entries;
+			std::string text;
+			std::vector<size_t> table; // Entry index plus one, 0 for an empty slot, the size is always a power of two
+
+			// Finds the slot of a checksum, or the empty slot where it would go
+			size_t Slot(unsigned long crc) const
+			{
+				// Checksums are already well mixed, so their low bits are used as is
+				size_t mask = table.size() - 1;
+				size_t slot = crc & mask;
+				while (table[slot] != 0 && entries[table[slot] - 1].crc != crc)
+					slot = (slot + 1) & mask;
+				return slot;
+			}
+
+		public:
+			size_t Size() const
+			{
+				return entries.size();
+			}
+
+			unsigned long Checksum(size_t i) const
+			{
+				return entries[i].crc;
+			}
+
+			// Name views stay valid until the next add or clear
+			std::string_view Name(size_t i) const
+			{
+				return std::string_view(text.data() + entries[i].offset, entries[i].length);
+			}
+
+			// Gets the name of a checksum, returns false if it has none
+			bool Find(unsigned long crc, std::string_view &name) const
+			{
+				if (table.empty())
+					return false;
+				size_t slot = Slot(crc);
+				if (table[slot] == 0)
+					return false;
+				name = Name(table[slot] - 1);
+				return true;
+			}
+
+			// Adds the name of a checksum that has none yet
+			void Add(unsigned long crc, std::string_view name)
+			{
+				// Keep the table at most half full
+				if ((entries.size() + 1) * 2 > table.size())
+				{
+					table.assign(std::max<size_t>(table.size() * 2, 0x100), 0);
+					for (size_t i = 0; i < entries.size(); i++)
+						table[Slot(entries[i].crc)] = i + 1;
+				}
+
+				table[Slot(crc)] = entries.size() + 1;
+				entries.push_back(Entry{ crc, text.size(), name.size() });
+				text.append(name);
+				text.push_back('\0');
+			}
+
+			void Clear()
+			{
+				if (!entries.empty())
+					std::fill(table.begin(), table.end(), 0);
+				entries.clear();
+				text.clear();
+			}
+	};
+
+	// Bytecode emitted from a run of tokens
+	struct Emission
+	{
 		std::vector<unsigned char> bytecode;
+		std::vector<ShortJump> short_jumps;
+		std::vector<size_t> block_parents;
+
+		ChecksumNames checksums; // Merges add names in order of first use, to match a serial pass
+
+		// Source locations, offsets are kept separately so they can follow the bytecode as it's rewritten
+		std::vector<SourceMapEntry> locations;
+		std::vector<size_t> location_offsets;
+
+		// Names of a checksum collision, the error detail is only built from them when the error is reported
+		// Failed runs are often thrown away, with the error never read
+		std::string_view collision[2];
+
+		// Fills in the detail of a checksum collision
+		void CollisionDetail(Error &error) const
+		{
+			if (error.code == ErrorCode::ChecksumCollision)
+				error.detail = std::string(collision[0]) + " == " + std::string(collision[1]);
+		}
+
+		// Empties the emission, keeping its buffers
+		void Clear()
+		{
+			bytecode.clear();
+			short_jumps.clear();
+			block_parents.clear();
+			checksums.Clear();
+			locations.clear();
+			location_offsets.clear();
+		}
+	};
+
+	// Block stacks of an emit, kept between emits so blocks don't allocate
+	// The jumps of nested RANDOM and SWITCH blocks share one list each, every block starts where its parent's jumps end
+	struct EmitStacks
+	{
+		struct RandomStack // Keeps track of RandomCase jumps
+		{
+			size_t address = 0;
+			size_t jump = 0, num_jumps = 0;
+			size_t first_end_jump = 0;
+		};
+		std::vector<RandomStack> random;
+		std::vector<size_t> end_jumps;
+		std::vector<signed long> weights;
+
+		struct ShortStack // Keeps track of FastIf, FastElse
+		{
+			size_t address = 0;
+			size_t block = 0;
+		};
+		std::vector<ShortStack> short_blocks;
+
+		struct SwitchStack // Keeps track of Case jumps
+		{
+			size_t first_case = 0;
+			size_t block = 0;
+		};
+		std::vector<SwitchStack> switches;
+		std::vector<size_t> cases;
+
+		// IF and SWITCH blocks, kept for relaxation
+		std::vector<size_t> blocks;
+
+		void Clear()
+		{
+			random.clear();
+			end_jumps.clear();
+			weights.clear();
+			short_blocks.clear();
+			switches.clear();
+			cases.clear();
+			blocks.clear();
+		}
+	};
+
+	using TokenIterator = std::vector<TokenBase*>::const_iterator;
+
+	// Emits bytecode for a run of tokens
+	// Errors are reported rather than thrown, so runs can be tried cheaply
+	// The detail of a checksum collision is left to Emission::CollisionDetail
+	static bool Emit(TokenIterator token_it, TokenIterator token_end, const TargetProps &target_props, const CompileOptions &options, Emission &emission, EmitStacks &stacks, Error &error)
+	{
+		QSCRIPT_TRACE_SCOPE("Emit");
+		stacks.Clear();
+
+		// Output
+		auto &bytecode = emission.bytecode;
+		auto &short_jumps = emission.short_jumps;
+		auto &block_parents = emission.block_parents;
+		auto &checksums = emission.checksums;
+		auto &locations = emission.locations;
+		auto &location_offsets = emission.location_offsets;
 
 		auto add_token = [&bytecode](Token token)
 			{
@@ -73,14 +358,14 @@ namespace QScript
 				bytecode.push_back((unsigned char)((raw >> 24) & 0xFF));
 			};
 
-		auto add_string = [&bytecode](const std::string &str)
+		auto add_string = [&bytecode](std::string_view str)
 			{
 				for (const auto &c : str)
 					bytecode.push_back((unsigned char)c);
 				bytecode.push_back(0);
 			};
 
-		auto add_string_sized = [&bytecode, &add_int, &add_string](const std::string &str)
+		auto add_string_sized = [&bytecode, &add_int, &add_string](std::string_view str)
 			{
 				add_int(str.size() + 1);
 				add_string(str);
@@ -95,14 +380,15 @@ namespace QScript
 				bytecode.at(to + 3) = (unsigned char)((relative >> 24) & 0xFF);
 			};
 
-		auto set_short_address = [&bytecode](size_t to, size_t address)
+		auto set_short_address = [&bytecode, &short_jumps](size_t to, size_t address, size_t block)
 			{
 				ptrdiff_t relative = (ptrdiff_t)address - (ptrdiff_t)(to);
 				bytecode.at(to + 0) = (unsigned char)((relative >> 0) & 0xFF);
 				bytecode.at(to + 1) = (unsigned char)((relative >> 8) & 0xFF);
+				short_jumps.push_back(ShortJump{ to - 1, address, block });
 			};
 
-		auto get_token_integer = [&bytecode](const TokenBase &token) -> signed long
+		auto get_token_integer = [](const TokenBase &token, signed long &value) -> bool
 			{
 				switch (token.type)
 				{
@@ -110,21 +396,21 @@ namespace QScript
 					case Token::HexInteger:
 					{
 						const auto &integer = (const TokenNumber &)token;
-						return integer.value;
-						break;
+						value = integer.value;
+						return true;
 					}
 					case Token::Float:
 					{
 						const auto &real = (const TokenReal &)token;
-						return (signed long)std::floor(real.value);
-						break;
+						value = (signed long)std::floor(real.value);
+						return true;
 					}
 					default:
-						throw std::runtime_error("Expected integer or float");
+						return false;
 				}
 			};
 
-		auto get_token_real = [&bytecode](const TokenBase &token) -> float
+		auto get_token_real = [](const TokenBase &token, float &value) -> bool
 			{
 				switch (token.type)
 				{
@@ -132,47 +418,52 @@ namespace QScript
 					case Token::HexInteger:
 					{
 						const auto &integer = (const TokenNumber &)token;
-						return (float)integer.value;
-						break;
+						value = (float)integer.value;
+						return true;
 					}
 					case Token::Float:
 					{
 						const auto &real = (const TokenReal &)token;
-						return real.value;
-						break;
+						value = real.value;
+						return true;
 					}
 					default:
-						throw std::runtime_error("Expected integer or float");
+						return false;
 				}
 			};
 
-		std::unordered_map<unsigned long, std::string> checksums;
-
-		std::unordered_map<std::string, unsigned long> labels;
-		std::vector<std::pair<unsigned long, std::string>> label_refs;
-
-		struct RandomStack // Keeps track of RandomCase jumps
-		{
-			size_t address = 0;
-			size_t jump = 0, num_jumps = 0;
-			std::vector<size_t> end_jumps;
-		};
-		std::stack<RandomStack> random_stack;
+		// Reports an error at a token
+		auto fail = [&error](ErrorCode code, const TokenBase *at) -> bool
+			{
+				error.code = code;
+				if (at != nullptr)
+				{
+					error.line = at->line;
+					error.column = at->column;
+				}
+				return false;
+			};
 
-		struct ShortStack // Keeps track of FastIf, FastElse
-		{
-			size_t address = 0;
-		};
-		std::stack<ShortStack> short_stack;
+		auto &random_stack = stacks.random;
+		auto &end_jumps = stacks.end_jumps;
+		auto &short_stack = stacks.short_blocks;
+		auto &switch_stack = stacks.switches;
+		auto &cases = stacks.cases;
+		auto &block_stack = stacks.blocks;
 
-		struct SwitchStack // Keeps track of Case jumps
-		{
-			std::vector<size_t> cases;
-		};
-		std::stack<SwitchStack> switch_stack;
+		auto push_block = [&block_parents, &block_stack]() -> size_t
+			{
+				size_t block = block_parents.size();
+				block_parents.push_back(block_stack.empty() ? NO_BLOCK : block_stack.back());
+				block_stack.push_back(block);
+				return block;
+			};
 
-		auto token_it = g_tokens.cbegin();
-		auto token_end = g_tokens.cend();
+		auto pop_block = [&block_stack]()
+			{
+				if (!block_stack.empty())
+					block_stack.pop_back();
+			};
 
 		auto token_can_pop = [&token_it, &token_end]() -> bool
 			{
@@ -181,28 +472,46 @@ namespace QScript
 			return true;
 		};
 
-		auto token_pop = [&token_it, &token_end]() -> const std::unique_ptr<TokenBase>&
+		// Popping or peeking past the end gives null
+		auto token_pop = [&token_it, &token_end]() -> TokenBase*
 		{
 			if (token_it == token_end)
-				throw std::runtime_error("Unexpected end of script");
-			const auto &token = *token_it;
+				return nullptr;
+			TokenBase *token = *token_it;
 			token_it++;
 			return token;
 		};
 
-		auto token_peek = [&token_it, &token_end]() -> const std::unique_ptr<TokenBase>&
+		auto token_peek = [&token_it, &token_end]() -> TokenBase*
 		{
 			if (token_it == token_end)
-				throw std::runtime_error("Unexpected end of script");
+				return nullptr;
 			return *token_it;
 		};
 
 		// Process tokens
+		const TokenBase *last_token = nullptr;
 		while (token_can_pop())
 		{
 			const auto &token = token_pop();
 			if (token == nullptr)
 				break;
+			last_token = token;
+
+			// Remember source location
+			if (options.source_map)
+			{
+				SourceMapEntry location{ 0, 0, (uint32_t)token->line, (uint32_t)token->column };
+				if (!location_offsets.empty() && location_offsets.back() == bytecode.size())
+				{
+					locations.back() = location;
+				}
+				else
+				{
+					locations.push_back(location);
+					location_offsets.push_back(bytecode.size());
+				}
+			}
 
 			switch (token->type)
 			{
@@ -211,8 +520,7 @@ namespace QScript
 					if (target_props.fast_if_else_case)
 					{
 						// Push switch stack
-						SwitchStack stack;
-						switch_stack.push(stack);
+						switch_stack.push_back(EmitStacks::SwitchStack{ cases.size(), push_block() });
 					}
 
 					// Push Switch
@@ -225,27 +533,29 @@ namespace QScript
 					{
 						// Get top of stack
 						if (switch_stack.empty())
-							throw std::runtime_error("Unexpected 'ENDSWITCH' (no 'SWITCH')");
+							return fail(ErrorCode::UnexpectedEndSwitch, token);
 
-						auto &switch_top = switch_stack.top();
+						auto &switch_top = switch_stack.back();
 						
 						// Resolve jumps
-						for (size_t i = 0; i < switch_top.cases.size(); i++)
+						for (size_t i = switch_top.first_case; i < cases.size(); i++)
 						{
-							size_t case_addr = switch_top.cases[i];
+							size_t case_addr = cases[i];
 
 							// Set jump to next case
-							if (i != switch_top.cases.size() - 1)
-								set_short_address(case_addr + 2, switch_top.cases[i + 1]);
+							if (i != cases.size() - 1)
+								set_short_address(case_addr + 2, cases[i + 1], switch_top.block);
 							else
-								set_short_address(case_addr + 2, bytecode.size());
+								set_short_address(case_addr + 2, bytecode.size(), switch_top.block);
 
 							// Set end jump address
-							if (i != 0)
-								set_short_address(case_addr - 2, bytecode.size() + 1);
+							if (i != switch_top.first_case)
+								set_short_address(case_addr - 2, bytecode.size() + 1, switch_top.block);
 						}
 
-						switch_stack.pop();
+						cases.resize(switch_top.first_case);
+						switch_stack.pop_back();
+						pop_block();
 					}
 
 					// Push EndSwitch
@@ -259,19 +569,19 @@ namespace QScript
 					{
 						// Get top of stack
 						if (switch_stack.empty())
-							throw std::runtime_error("Unexpected 'CASE' or 'DEFAULT' (no 'SWITCH')");
+							return fail(ErrorCode::UnexpectedCase, token);
 
-						auto &switch_top = switch_stack.top();
+						auto &switch_top = switch_stack.back();
 
 						// If this isn't the first case, add a jump to the end
-						if (!switch_top.cases.empty())
+						if (cases.size() != switch_top.first_case)
 						{
 							add_token(Token::ShortJump);
 							add_short(0);
 						}
 
 						// Push case address
-						switch_top.cases.push_back(bytecode.size());
+						cases.push_back(bytecode.size());
 
 						// Push Case and short jump
 						add_token(token->type);
@@ -290,7 +600,7 @@ namespace QScript
 					if (target_props.fast_if_else_case)
 					{
 						// Push FastIf
-						short_stack.emplace(ShortStack{ bytecode.size() });
+						short_stack.push_back(EmitStacks::ShortStack{ bytecode.size(), push_block() });
 						add_token(Token::FastIf);
 						add_short(0);
 					}
@@ -307,17 +617,18 @@ namespace QScript
 					{
 						// Set FastIf jump address
 						if (short_stack.empty())
-							throw std::runtime_error("Unexpected 'ELSE' (no 'IF')");
+							return fail(ErrorCode::UnexpectedElse, token);
 
-						auto &if_stack = short_stack.top();
+						auto &if_stack = short_stack.back();
 						if (bytecode[if_stack.address] != (unsigned char)Token::FastIf)
-							throw std::runtime_error("Unexpected 'ELSE' (no 'IF')");
+							return fail(ErrorCode::UnexpectedElse, token);
 
-						set_short_address(if_stack.address + 1, bytecode.size() + 3);
-						short_stack.pop();
+						size_t block = if_stack.block;
+						set_short_address(if_stack.address + 1, bytecode.size() + 3, block);
+						short_stack.pop_back();
 
 						// Push FastElse
-						short_stack.emplace(ShortStack{ bytecode.size() });
+						short_stack.push_back(EmitStacks::ShortStack{ bytecode.size(), block });
 						add_token(Token::FastElse);
 						add_short(0);
 					}
@@ -334,14 +645,15 @@ namespace QScript
 					{
 						// Set FastIf/FastElse jump address
 						if (short_stack.empty())
-							throw std::runtime_error("Unexpected 'ENDIF' (no 'IF' or 'ELSE')");
+							return fail(ErrorCode::UnexpectedEndIf, token);
 
-						auto &if_stack = short_stack.top();
+						auto &if_stack = short_stack.back();
 						if (bytecode[if_stack.address] != (unsigned char)Token::FastIf && bytecode[if_stack.address] != (unsigned char)Token::FastElse)
-							throw std::runtime_error("Unexpected 'ELSE' (no 'IF' or 'ELSE')");
+							return fail(ErrorCode::UnexpectedEndIf, token);
 
-						set_short_address(if_stack.address + 1, bytecode.size() + 1);
-						short_stack.pop();
+						set_short_address(if_stack.address + 1, bytecode.size() + 1, if_stack.block);
+						short_stack.pop_back();
+						pop_block();
 					}
 
 					// Push EndIf
@@ -353,20 +665,26 @@ namespace QScript
 				{
 					// Get checksum of string
 					const auto &str = (const TokenString&)*token;
-					unsigned long crc = CRC(str.value.c_str());
+					unsigned long crc = CRC(str.value.data());
 
 					// Remember checksum name
-					auto find = checksums.find(crc);
-					if (find != checksums.end())
+					std::string_view name;
+					if (checksums.Find(crc, name))
 					{
 						// Check if there's a collision
-						if (SimpleString(find->second) != SimpleString(str.value))
-							throw std::runtime_error("Checksum collision (" + find->second + " == " + str.value + ")");
+						if (!SimpleStringEqual(name, str.value))
+						{
+							QSCRIPT_PROBE3(checksum_collision, (uint32_t)crc, name.data(), str.value.data());
+							error.checksum = (uint32_t)crc;
+							emission.collision[0] = name;
+							emission.collision[1] = str.value;
+							return fail(ErrorCode::ChecksumCollision, token);
+						}
 					}
 					else
 					{
 						// Set checksum
-						checksums[crc] = str.value;
+						checksums.Add(crc, str.value);
 					}
 
 					if (token->type == Token::Arg)
@@ -418,16 +736,24 @@ namespace QScript
 					const auto &token_y = token_pop();
 					const auto &token_rp = token_pop();
 
+					if (token_rp == nullptr)
+						return fail(ErrorCode::UnexpectedEndOfScript, token);
 					if (token_lp->type != Token::OpenParenth)
-						throw std::runtime_error("Expected '('");
+						return fail(ErrorCode::ExpectedOpenParenth, token_lp);
 					if (token_comma->type != Token::Comma)
-						throw std::runtime_error("Expected ','");
+						return fail(ErrorCode::ExpectedComma, token_comma);
 					if (token_rp->type != Token::CloseParenth)
-						throw std::runtime_error("Expected ')'");
+						return fail(ErrorCode::ExpectedCloseParenth, token_rp);
+
+					float x, y;
+					if (!get_token_real(*token_x, x))
+						return fail(ErrorCode::ExpectedNumber, token_x);
+					if (!get_token_real(*token_y, y))
+						return fail(ErrorCode::ExpectedNumber, token_y);
 
 					add_token(Token::Pair);
-					add_real(get_token_real(*token_x));
-					add_real(get_token_real(*token_y));
+					add_real(x);
+					add_real(y);
 					break;
 				}
 				case Token::Vector:
@@ -440,25 +766,43 @@ namespace QScript
 					const auto &token_z = token_pop();
 					const auto &token_rp = token_pop();
 
+					if (token_rp == nullptr)
+						return fail(ErrorCode::UnexpectedEndOfScript, token);
 					if (token_lp->type != Token::OpenParenth)
-						throw std::runtime_error("Expected '('");
+						return fail(ErrorCode::ExpectedOpenParenth, token_lp);
 					if (token_comma_x->type != Token::Comma)
-						throw std::runtime_error("Expected ','");
+						return fail(ErrorCode::ExpectedComma, token_comma_x);
 					if (token_comma_y->type != Token::Comma)
-						throw std::runtime_error("Expected ','");
+						return fail(ErrorCode::ExpectedComma, token_comma_y);
 					if (token_rp->type != Token::CloseParenth)
-						throw std::runtime_error("Expected ')'");
+						return fail(ErrorCode::ExpectedCloseParenth, token_rp);
+
+					float x, y, z;
+					if (!get_token_real(*token_x, x))
+						return fail(ErrorCode::ExpectedNumber, token_x);
+					if (!get_token_real(*token_y, y))
+						return fail(ErrorCode::ExpectedNumber, token_y);
+					if (!get_token_real(*token_z, z))
+						return fail(ErrorCode::ExpectedNumber, token_z);
 
 					add_token(Token::Vector);
-					add_real(get_token_real(*token_x));
-					add_real(get_token_real(*token_y));
-					add_real(get_token_real(*token_z));
+					add_real(x);
+					add_real(y);
+					add_real(z);
 					break;
 				}
 				case Token::EndOfLine:
 				{
 					// Don't add multiple end of lines in a row
-					add_token(Token::EndOfLine);
+					if (options.line_numbers)
+					{
+						add_token(Token::EndOfLineNumber);
+						add_int(token->line);
+					}
+					else
+					{
+						add_token(Token::EndOfLine);
+					}
 					while (token_can_pop())
 					{
 						const auto &next_token = token_peek();
@@ -475,32 +819,43 @@ namespace QScript
 				{
 					// Parse weight list
 					const auto &token_lp = token_pop();
+					if (token_lp == nullptr)
+						return fail(ErrorCode::UnexpectedEndOfScript, token);
 					if (token_lp->type != Token::OpenParenth)
-						throw std::runtime_error("Expected '('");
+						return fail(ErrorCode::ExpectedOpenParenth, token_lp);
 
-					std::vector<signed long> weights;
+					auto &weights = stacks.weights;
+					weights.clear();
 					while (1)
 					{
 						// Grab number
 						const auto &token_number = token_pop();
+						if (token_number == nullptr)
+							return fail(ErrorCode::UnexpectedEndOfScript, token);
 						if (token_number->type == Token::CloseParenth)
 							break;
-						weights.push_back(get_token_integer(*token_number));
+						signed long weight;
+						if (!get_token_integer(*token_number, weight))
+							return fail(ErrorCode::ExpectedNumber, token_number);
+						weights.push_back(weight);
 
 						// Grab comma or close parenth
 						const auto &token_next = token_pop();
+						if (token_next == nullptr)
+							return fail(ErrorCode::UnexpectedEndOfScript, token);
 						if (token_next->type == Token::CloseParenth)
 							break;
 						if (token_next->type != Token::Comma)
-							throw std::runtime_error("Expected ',' or ')'");
+							return fail(ErrorCode::ExpectedCommaOrCloseParenth, token_next);
 					}
 
 					// Create random stack
-					RandomStack random;
+					EmitStacks::RandomStack random;
 					random.address = bytecode.size();
 					random.jump = 0;
 					random.num_jumps = weights.size();
-					random_stack.push(random);
+					random.first_end_jump = end_jumps.size();
+					random_stack.push_back(random);
 
 					// Push bytecode
 					add_token(token->type);
@@ -515,16 +870,16 @@ namespace QScript
 				{
 					// Get top of stack
 					if (random_stack.empty())
-						throw std::runtime_error("Unexpected 'RANDOMCASE' (no random)");
+						return fail(ErrorCode::UnexpectedRandomCase, token);
 
-					auto &random = random_stack.top();
+					auto &random = random_stack.back();
 					if (random.jump >= random.num_jumps)
-						throw std::runtime_error("Unexpected 'RANDOMCASE' (more cases than weights)");
+						return fail(ErrorCode::TooManyRandomCases, token);
 
 					// If this isn't the first jump, add a jump to the end
 					if (random.jump != 0)
 					{
-						random.end_jumps.push_back(bytecode.size());
+						end_jumps.push_back(bytecode.size());
 						add_token(Token::Jump);
 						add_int(0);
 					}
@@ -539,18 +894,31 @@ namespace QScript
 				{
 					// Get top of stack
 					if (random_stack.empty())
-						throw std::runtime_error("Unexpected 'RANDOMEND' (no random)");
+						return fail(ErrorCode::UnexpectedRandomEnd, token);
 
-					auto &random = random_stack.top();
+					auto &random = random_stack.back();
 					if (random.jump != random.num_jumps)
-						throw std::runtime_error("Unexpected 'RANDOMEND' (random was incomplete)");
+						return fail(ErrorCode::IncompleteRandom, token);
 
 					// Set end jump addresses
-					for (const auto &end_jump : random.end_jumps)
-						set_address(end_jump + 1, bytecode.size());
+					for (size_t i = random.first_end_jump; i < end_jumps.size(); i++)
+						set_address(end_jumps[i] + 1, bytecode.size());
 
 					// Pop stack
-					random_stack.pop();
+					end_jumps.resize(random.first_end_jump);
+					random_stack.pop_back();
+					break;
+				}
+				case Token::KeywordScript:
+				{
+					QSCRIPT_PROBE2(compile_script_begin, bytecode.size(), token->line);
+					add_token(Token::KeywordScript);
+					break;
+				}
+				case Token::KeywordEndScript:
+				{
+					add_token(Token::KeywordEndScript);
+					QSCRIPT_PROBE2(compile_script_end, bytecode.size(), token->line);
 					break;
 				}
 				default:
@@ -560,26 +928,698 @@ namespace QScript
 				}
 			}
 		}
-		g_tokens.clear();
 
 		// Check if stacks are empty
 		if (!switch_stack.empty())
-			throw std::runtime_error("Unexpected end of script (missing 'ENDSWITCH')");
+			return fail(ErrorCode::MissingEndSwitch, last_token);
 		if (!random_stack.empty())
-			throw std::runtime_error("Unexpected end of script (missing 'RANDOMEND')");
+			return fail(ErrorCode::MissingRandomEnd, last_token);
 		if (!short_stack.empty())
-			throw std::runtime_error("Unexpected end of script (missing 'ENDIF')");
+			return fail(ErrorCode::MissingEndIf, last_token);
+		return true;
+	}
+
+	// Appends an emission to another, as if both were emitted in one pass
+	// The line offset is added to the source locations being appended
+	// Fails on a checksum collision between the two, where the emission is left partly merged
+	static bool MergeEmission(Emission &into, const Emission &from, Error &error, uint32_t line_offset = 0)
+	{
+		size_t offset = into.bytecode.size();
+		size_t block_offset = into.block_parents.size();
+
+		// Append bytecode, jumps are relative so it can be copied as is
+		into.bytecode.insert(into.bytecode.end(), from.bytecode.begin(), from.bytecode.end());
+
+		for (const auto &jump : from.short_jumps)
+			into.short_jumps.push_back(ShortJump{ jump.address + offset, jump.target + offset, jump.block + block_offset });
+		for (const auto &parent : from.block_parents)
+			into.block_parents.push_back(parent == NO_BLOCK ? NO_BLOCK : parent + block_offset);
+
+		// Merge checksums
+		for (size_t i = 0; i < from.checksums.Size(); i++)
+		{
+			unsigned long crc = from.checksums.Checksum(i);
+			std::string_view name = from.checksums.Name(i);
+			std::string_view found;
+			if (into.checksums.Find(crc, found))
+			{
+				// Check if there's a collision
+				if (!SimpleStringEqual(found, name))
+				{
+					QSCRIPT_PROBE3(checksum_collision, (uint32_t)crc, found.data(), name.data());
+					error.code = ErrorCode::ChecksumCollision;
+					error.checksum = (uint32_t)crc;
+					into.collision[0] = found;
+					into.collision[1] = name;
+					return false;
+				}
+			}
+			else
+			{
+				into.checksums.Add(crc, name);
+			}
+		}
+
+		// Append locations
+		for (size_t i = 0; i < from.locations.size(); i++)
+		{
+			size_t location_offset = from.location_offsets[i] + offset;
+			SourceMapEntry location = from.locations[i];
+			location.line += line_offset;
+			if (!into.location_offsets.empty() && into.location_offsets.back() == location_offset)
+			{
+				into.locations.back() = location;
+			}
+			else
+			{
+				into.locations.push_back(location);
+				into.location_offsets.push_back(location_offset);
+			}
+		}
+		return true;
+	}
+
+	// Splits tokens at the start of top level lines, into runs of at least the given size
+	static std::vector<TokenIterator> SplitTokens(const std::vector<TokenBase*> &tokens, size_t min_tokens)
+	{
+		std::vector<TokenIterator> splits;
+		splits.push_back(tokens.cbegin());
+
+		int depth = 0;
+		size_t count = 0;
+		bool line_start = false;
+		for (auto it = tokens.cbegin(); it != tokens.cend(); ++it, count++)
+		{
+			Token type = (*it)->type;
+
+			// Split before the first token of a line outside of any block
+			// The split can't fall between end of lines, since repeated end of lines are merged
+			if (depth == 0 && line_start && type != Token::EndOfLine && count >= min_tokens)
+			{
+				splits.push_back(it);
+				count = 0;
+			}
+			line_start = type == Token::EndOfLine;
+
+			switch (type)
+			{
+				case Token::KeywordScript:
+				case Token::KeywordIf:
+				case Token::KeywordSwitch:
+				case Token::KeywordBegin:
+				case Token::KeywordRandom:
+				case Token::KeywordRandom2:
+				case Token::KeywordRandomNoRepeat:
+				case Token::KeywordRandomPermute:
+				case Token::StartStruct:
+				case Token::StartArray:
+				case Token::OpenParenth:
+					depth++;
+					break;
+				case Token::KeywordEndScript:
+				case Token::KeywordEndIf:
+				case Token::KeywordEndSwitch:
+				case Token::KeywordRepeat:
+				case Token::KeywordRandomEnd:
+				case Token::EndStruct:
+				case Token::EndArray:
+				case Token::CloseParenth:
+					depth--;
+					break;
+				default:
+					break;
+			}
+		}
+
+		splits.push_back(tokens.cend());
+		return splits;
+	}
+
+	// Emits top level runs of tokens concurrently and merges them
+	// Returns false if any run fails to compile on its own, the serial pass then reports the error
+	static bool EmitParallel(const std::vector<TokenBase*> &tokens, const TargetProps &target_props, const CompileOptions &options, Emission &emission)
+	{
+		unsigned int threads = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+		if (threads < 2)
+			return false;
+
+		std::vector<TokenIterator> splits = SplitTokens(tokens, tokens.size() / threads + 1);
+		size_t runs = splits.size() - 1;
+		if (runs < 2)
+			return false;
+
+		// Emit runs
+		std::vector<Emission> emissions(runs);
+		std::vector<char> failed(runs, 0);
+		std::vector<std::thread> workers;
+		workers.reserve(runs);
+		for (size_t i = 0; i < runs; i++)
+		{
+			workers.emplace_back([&, i]()
+				{
+					try
+					{
+						Error error;
+						EmitStacks stacks;
+						if (!Emit(splits[i], splits[i + 1], target_props, options, emissions[i], stacks, error))
+							failed[i] = 1;
+					}
+					catch (const std::exception &)
+					{
+						failed[i] = 1;
+					}
+				});
+		}
+		for (auto &worker : workers)
+			worker.join();
 
-		// Write out checksums
-		for (const auto &checksum : checksums)
+		for (const auto &fail : failed)
 		{
-			add_token(Token::ChecksumName);
-			add_int(checksum.first);
-			add_string(checksum.second.c_str());
+			if (fail)
+				return false;
+		}
+
+		// Merge runs in order
+		QSCRIPT_TRACE_SCOPE("MergeEmissions");
+		Error error;
+		emission = std::move(emissions[0]);
+		for (size_t i = 1; i < runs; i++)
+		{
+			if (!MergeEmission(emission, emissions[i], error))
+				return false;
+		}
+		return true;
+	}
+
+	// Compile cache
+	struct CompileCacheData
+	{
+		// Emissions keyed by block source and the options that affect emission
+		std::unordered_map<std::string, Emission> blocks;
+	};
+
+	CompileCache::CompileCache() : data(new CompileCacheData())
+	{
+
+	}
+
+	CompileCache::~CompileCache()
+	{
+
+	}
+
+	// Checks if a line starts a block that can be cached, being a SCRIPT or a definition
+	// Only lines outside of SCRIPT bodies are checked, other blocks that aren't top level fail to emit on their own
+	static bool IsBlockStart(const char *text, size_t length, size_t i)
+	{
+		size_t k = i;
+		while (k < length && (std::isalnum((unsigned char)text[k]) || text[k] == '_'))
+			k++;
+		if (k == i || std::isdigit((unsigned char)text[i]))
+			return false;
+		if (k - i == 6 && std::strncmp(text + i, "SCRIPT", 6) == 0)
+			return k < length && (text[k] == ' ' || text[k] == '\t');
+		while (k < length && (text[k] == ' ' || text[k] == '\t'))
+			k++;
+		return k < length && text[k] == '=' && (k + 1 >= length || text[k + 1] != '=');
+	}
+
+	// Checks if a line starts with a keyword, after any indentation
+	static bool IsKeywordLine(const char *text, size_t length, size_t i, std::string_view keyword)
+	{
+		while (i < length && (text[i] == ' ' || text[i] == '\t'))
+			i++;
+		if (length - i < keyword.size() || std::strncmp(text + i, keyword.data(), keyword.size()) != 0)
+			return false;
+		i += keyword.size();
+		return i >= length || !(std::isalnum((unsigned char)text[i]) || text[i] == '_');
+	}
+
+	// Emits blocks of the source, reusing the emissions of blocks that didn't change
+	// Returns false if a block can't be lexed or emitted on its own, a full compile then reports the error
+	static bool EmitCached(std::string_view source, const TargetProps &target_props, const CompileOptions &options, CompileCache &cache, Emission &emission)
+	{
+		QSCRIPT_TRACE_SCOPE("EmitCached");
+
+		const char *text = source.data();
+		size_t length = SourceLength(source);
+
+		// Split source into blocks
+		// SCRIPT bodies aren't always indented, so lines inside them are never taken as block starts
+		std::vector<size_t> splits;
+		splits.push_back(0);
+		bool in_script = IsKeywordLine(text, length, 0, "SCRIPT");
+		for (const auto &split : FindSplitPoints(text, length, 0))
+		{
+			if (!in_script && IsBlockStart(text, length, split))
+				splits.push_back(split);
+			if (IsKeywordLine(text, length, split, "SCRIPT"))
+				in_script = true;
+			else if (IsKeywordLine(text, length, split, "ENDSCRIPT"))
+				in_script = false;
+		}
+		splits.push_back(length);
+
+		// Emit blocks
+		// Line numbers are written into the bytecode, so those blocks also depend on the line they start at
+		std::unordered_map<std::string, Emission> &blocks = cache.data->blocks;
+		std::unordered_map<std::string, Emission> used;
+
+		auto fail = [&blocks, &used]() -> bool
+			{
+				// Give back the blocks that were taken from the cache
+				for (auto &block : used)
+					blocks[block.first] = std::move(block.second);
+				return false;
+			};
+
+		int line = 1;
+		for (size_t i = 0; i + 1 < splits.size(); i++)
+		{
+			size_t start = splits[i];
+			size_t size = splits[i + 1] - start;
+
+			std::string key(text + start, size);
+			key.push_back('\0');
+			key.push_back((char)target_props.fast_if_else_case);
+			key.push_back((char)options.source_map);
+			key.push_back((char)options.line_numbers);
+			if (options.line_numbers)
+				key += std::to_string(line);
+
+			auto find = used.find(key);
+			if (find == used.end())
+			{
+				auto find_cached = blocks.find(key);
+				if (find_cached != blocks.end())
+				{
+					find = used.emplace(key, std::move(find_cached->second)).first;
+				}
+				else
+				{
+					LexerState lexer;
+					if (options.line_numbers)
+						lexer.line = lexer.token_line = line;
+					LexRun(text + start, size, lexer);
+					if (lexer.error)
+						return fail();
+
+					Emission block;
+					EmitStacks stacks;
+					Error error;
+					if (!Emit(lexer.tokens.cbegin(), lexer.tokens.cend(), target_props, options, block, stacks, error))
+						return fail();
+					find = used.emplace(key, std::move(block)).first;
+				}
+			}
+
+			Error error;
+			if (!MergeEmission(emission, find->second, error, options.line_numbers ? 0 : (uint32_t)(line - 1)))
+				return fail();
+			line += (int)std::count(text + start, text + start + size, '\n');
+		}
+
+		// Only keep blocks that are still in use
+		blocks = std::move(used);
+		return true;
+	}
+
+	// Compiler session
+	struct CompilerData
+	{
+		LexerState lexer;
+		Emission emission;
+		EmitStacks stacks;
+
+		// Blocks being lowered
+		std::vector<bool> lower_blocks;
+
+		// Per target copies of the jumps and source locations
+		std::vector<ShortJump> short_jumps;
+		std::vector<size_t> location_offsets;
+	};
+
+	// A caller's buffer to compile a single target into
+	struct OutputBuffer
+	{
+		std::span<std::byte> buffer;
+		size_t size = 0; // Size of the bytecode, even when it doesn't fit
+	};
+
+	// Passes the checksum names a target keeps to put as bytecode, in order of first use, followed by EndOfFile
+	// Stripped names go to the symbols when there are any
+	template <typename Put>
+	static void PutChecksumNames(const ChecksumNames &checksums, const std::unordered_set<unsigned long> &used, const CompileOptions &options, Symbols *symbols, Put &&put)
+	{
+		QSCRIPT_TRACE_SCOPE("ChecksumNames");
+		static const unsigned char terminator = 0;
+		for (size_t j = 0; j < checksums.Size(); j++)
+		{
+			unsigned long crc = checksums.Checksum(j);
+			std::string_view name = checksums.Name(j);
+
+			// Skip names that aren't referenced anymore
+			if (options.optimize_branches && used.find(crc) == used.end())
+				continue;
+
+			// Skip names the decompiler already knows about
+			if (options.shared_symbols != nullptr)
+			{
+				auto find = options.shared_symbols->find((uint32_t)crc);
+				if (find != options.shared_symbols->end() && find->second == name)
+					continue;
+			}
+
+			// Move name out to the symbols
+			if (options.strip_checksum_names)
+			{
+				if (symbols != nullptr)
+					(*symbols)[(uint32_t)crc] = std::string(name);
+				continue;
+			}
+
+			unsigned char record[5] = { (unsigned char)Token::ChecksumName };
+			for (int k = 0; k < 4; k++)
+				record[1 + k] = (unsigned char)((crc >> (k * 8)) & 0xFF);
+			put(record, sizeof(record));
+			put((const unsigned char *)name.data(), name.size());
+			put(&terminator, 1);
 		}
 
 		// Terminate bytecode
-		add_token(Token::EndOfFile);
-		return bytecode;
+		static const unsigned char end_of_file = (unsigned char)Token::EndOfFile;
+		put(&end_of_file, 1);
+	}
+
+	Compiler::Compiler() : data(new CompilerData())
+	{
+
+	}
+
+	Compiler::~Compiler()
+	{
+
+	}
+
+	// Compiles into results that have already been made, keeping their buffers
+	// Given an output buffer, a single target is written there instead, without results
+	// Unrecognized characters are only errors when asked for, otherwise they're printed and the tokens before them are compiled
+	static bool Compile(CompilerData &data, std::string_view source, const Target *targets, size_t num_targets, const CompileOptions &options, CompileResult *results, OutputBuffer *output, bool lex_errors, Error &error)
+	{
+		// Prepare results
+		if (output != nullptr)
+			output->size = 0;
+		for (size_t i = 0; results != nullptr && i < num_targets; i++)
+		{
+			results[i].bytecode.clear();
+			results[i].symbols = Symbols();
+			results[i].source_map.files.clear();
+			results[i].source_map.entries.clear();
+		}
+		if (num_targets == 0)
+			return true;
+
+		QSCRIPT_TRACE_SCOPE("Compile");
+
+		// Time phases for the stats
+		Stats *stats = options.stats;
+		PhaseTimer timer;
+		if (stats != nullptr)
+		{
+			*stats = Stats();
+			stats->input_bytes = SourceLength(source);
+		}
+
+		// Get target properties
+		// When any target uses short jumps, the bytecode is emitted in that form and lowered for the others
+		TargetProps target_props = { false };
+		for (size_t i = 0; i < num_targets; i++)
+			target_props.fast_if_else_case |= s_target_props[(int)targets[i]].fast_if_else_case;
+
+		// Emit bytecode
+		Emission &emission = data.emission;
+		emission.Clear();
+		if (options.cache == nullptr || !EmitCached(source, target_props, options, *options.cache, emission))
+		{
+			// Perform lexical analysis
+			LexerState &lexer = data.lexer;
+			lexer.Reset();
+			if (options.parallel)
+				LexParallel(source, options.threads, lexer);
+			else
+				Lex(source, lexer);
+
+			if (stats != nullptr)
+			{
+				timer.Lap(stats->lex_seconds, stats->lex_allocations);
+				stats->source_tokens = lexer.tokens.size();
+				stats->peak_token_bytes = lexer.TokenBytes();
+				for (const TokenBase *token : lexer.tokens)
+				{
+					if (token->type == Token::Label)
+						stats->labels++;
+					else if (token->type == Token::NameChecksum || token->type == Token::ArgChecksum)
+						stats->unresolved_checksums++;
+				}
+			}
+
+			if (lexer.error)
+			{
+				if (lex_errors)
+				{
+					error = lexer.error;
+					return false;
+				}
+				printf("%s\n", lexer.error.Message().c_str());
+			}
+
+			emission.Clear();
+			if (!options.parallel || !EmitParallel(lexer.tokens, target_props, options, emission))
+			{
+				emission.Clear();
+				if (!Emit(lexer.tokens.cbegin(), lexer.tokens.cend(), target_props, options, emission, data.stacks, error))
+				{
+					emission.CollisionDetail(error);
+					return false;
+				}
+			}
+		}
+		if (stats != nullptr)
+			timer.Lap(stats->emit_seconds, stats->emit_allocations);
+
+		auto &bytecode = emission.bytecode;
+		auto &short_jumps = emission.short_jumps;
+		auto &block_parents = emission.block_parents;
+		auto &checksums = emission.checksums;
+		auto &locations = emission.locations;
+		auto &location_offsets = emission.location_offsets;
+
+		// Fall back to long IF and SWITCH blocks where short jumps are out of range
+		QSCRIPT_TRACE_SCOPE("Finish");
+		RelaxBlocks(bytecode, short_jumps, block_parents, data.lower_blocks, &location_offsets);
+
+		// Finish each target from the shared bytecode
+		for (size_t i = 0; i < num_targets; i++)
+		{
+			// An output buffer is written from the shared bytecode once it's finished in place
+			// Otherwise the last target takes the shared bytecode, handing its old buffers to the session
+			std::vector<unsigned char> &target_bytecode = (output != nullptr) ? bytecode : results[i].bytecode;
+			std::vector<ShortJump> &target_short_jumps = (output != nullptr) ? short_jumps : data.short_jumps;
+			std::vector<size_t> &target_location_offsets = (output != nullptr) ? location_offsets : data.location_offsets;
+			if (output == nullptr && i + 1 == num_targets)
+			{
+				target_bytecode.swap(bytecode);
+				target_short_jumps.swap(short_jumps);
+				target_location_offsets.swap(location_offsets);
+			}
+			else if (output == nullptr)
+			{
+				target_bytecode.assign(bytecode.begin(), bytecode.end());
+				target_short_jumps.assign(short_jumps.begin(), short_jumps.end());
+				target_location_offsets.assign(location_offsets.begin(), location_offsets.end());
+			}
+
+			// Lower to long IF and SWITCH blocks
+			if (target_props.fast_if_else_case && !s_target_props[(int)targets[i]].fast_if_else_case)
+			{
+				data.lower_blocks.assign(block_parents.size(), true);
+				LowerBlocks(target_bytecode, target_short_jumps, data.lower_blocks, &target_location_offsets);
+			}
+
+			// Optimize branches, dropping names that were only used by removed code
+			std::unordered_set<unsigned long> used;
+			if (options.optimize_branches)
+			{
+				OptimizeBranches(target_bytecode, &target_location_offsets);
+				used = GetUsedChecksums(target_bytecode);
+			}
+
+			if (output != nullptr)
+			{
+				// Size up the bytecode first, so nothing is written to a buffer that's too small
+				size_t size = target_bytecode.size();
+				PutChecksumNames(checksums, used, options, nullptr, [&](const unsigned char *, size_t length) { size += length; });
+				output->size = size;
+				if (size > output->buffer.size())
+					continue;
+
+				unsigned char *p = (unsigned char *)output->buffer.data();
+				std::memcpy(p, target_bytecode.data(), target_bytecode.size());
+				p += target_bytecode.size();
+				PutChecksumNames(checksums, used, options, nullptr, [&](const unsigned char *piece, size_t length) { std::memcpy(p, piece, length); p += length; });
+				continue;
+			}
+
+			// Build source map
+			CompileResult &result = results[i];
+			if (options.source_map)
+				BuildSourceMap(result.source_map, options.source_name, locations, target_location_offsets);
+
+			// Write out checksums
+			PutChecksumNames(checksums, used, options, &result.symbols, [&](const unsigned char *piece, size_t length) { target_bytecode.insert(target_bytecode.end(), piece, piece + length); });
+		}
+
+		if (stats != nullptr)
+		{
+			timer.Lap(stats->finish_seconds, stats->finish_allocations);
+			if (output != nullptr)
+			{
+				stats->output_bytes += output->size;
+				if (output->size <= output->buffer.size())
+				{
+					char *p_start = (char *)output->buffer.data();
+					CountTokens(p_start, p_start + output->size, *stats);
+				}
+			}
+			for (size_t i = 0; results != nullptr && i < num_targets; i++)
+			{
+				char *p_start = (char *)results[i].bytecode.data();
+				stats->output_bytes += results[i].bytecode.size();
+				CountTokens(p_start, p_start + results[i].bytecode.size(), *stats);
+			}
+		}
+		return true;
+	}
+
+	// Compiles between the compile_begin and compile_end probes
+	static bool ProbedCompile(CompilerData &data, std::string_view source, const Target *targets, size_t num_targets, const CompileOptions &options, CompileResult *results, OutputBuffer *output, bool lex_errors, Error &error)
+	{
+		QSCRIPT_PROBE2(compile_begin, source.size(), num_targets);
+		bool compiled = Compile(data, source, targets, num_targets, options, results, output, lex_errors, error);
+		QSCRIPT_PROBE2(compile_end, (compiled && num_targets != 0) ? ((output != nullptr) ? output->size : results[0].bytecode.size()) : 0, compiled);
+		return compiled;
+	}
+
+	// Compiles for the error code functions, where nothing may be thrown
+	static bool CompileNoThrow(CompilerData &data, std::string_view source, const Target *targets, size_t num_targets, const CompileOptions &options, CompileResult *results, OutputBuffer *output, Error &error) noexcept
+	{
+		try
+		{
+			return ProbedCompile(data, source, targets, num_targets, options, results, output, true, error);
+		}
+		catch (const std::exception &e)
+		{
+			error = Error();
+			error.code = ErrorCode::Internal;
+			error.detail = e.what();
+			return false;
+		}
+	}
+
+	static void CompileOrThrow(CompilerData &data, std::string_view source, const Target *targets, size_t num_targets, const CompileOptions &options, CompileResult *results, OutputBuffer *output)
+	{
+		Error error;
+		if (!ProbedCompile(data, source, targets, num_targets, options, results, output, false, error))
+			throw std::runtime_error(error.Message());
+	}
+
+	void Compiler::Compile(std::string_view source, const std::vector<Target> &targets, const CompileOptions &options, std::vector<CompileResult> &results)
+	{
+		results.resize(targets.size());
+		CompileOrThrow(*data, source, targets.data(), targets.size(), options, results.data(), nullptr);
+	}
+
+	void Compiler::Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result)
+	{
+		CompileOrThrow(*data, source, &target, 1, options, &result, nullptr);
+	}
+
+	size_t Compiler::Compile(std::string_view source, Target target, const CompileOptions &options, std::span<std::byte> output)
+	{
+		OutputBuffer buffer;
+		buffer.buffer = output;
+		CompileOrThrow(*data, source, &target, 1, options, nullptr, &buffer);
+		return buffer.size;
+	}
+
+	bool Compiler::Compile(std::string_view source, const std::vector<Target> &targets, const CompileOptions &options, std::vector<CompileResult> &results, Error &error) noexcept
+	{
+		error = Error();
+		if (results.size() < targets.size())
+		{
+			try
+			{
+				results.resize(targets.size());
+			}
+			catch (const std::exception &e)
+			{
+				error.code = ErrorCode::Internal;
+				error.detail = e.what();
+				return false;
+			}
+		}
+		return CompileNoThrow(*data, source, targets.data(), targets.size(), options, results.data(), nullptr, error);
+	}
+
+	bool Compiler::Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result, Error &error) noexcept
+	{
+		error = Error();
+		return CompileNoThrow(*data, source, &target, 1, options, &result, nullptr, error);
+	}
+
+	// Compile function
+	void Compile(std::string_view source, const std::vector<Target> &targets, const CompileOptions &options, std::vector<CompileResult> &results)
+	{
+		CompilerData data;
+		results.clear();
+		results.resize(targets.size());
+		CompileOrThrow(data, source, targets.data(), targets.size(), options, results.data(), nullptr);
+	}
+
+	void Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result)
+	{
+		CompilerData data;
+		result = CompileResult();
+		CompileOrThrow(data, source, &target, 1, options, &result, nullptr);
+	}
+
+	std::vector<unsigned char> Compile(std::string_view source, Target target, const CompileOptions &options)
+	{
+		CompileResult result;
+		Compile(source, target, options, result);
+		return std::move(result.bytecode);
+	}
+
+	size_t Compile(std::string_view source, Target target, const CompileOptions &options, std::span<std::byte> output)
+	{
+		// Each thread keeps a session, so compiling into buffers over and over doesn't reallocate
+		static thread_local Compiler compiler;
+		return compiler.Compile(source, target, options, output);
+	}
+
+	bool Compile(std::string_view source, Target target, const CompileOptions &options, CompileResult &result, Error &error) noexcept
+	{
+		error = Error();
+		try
+		{
+			CompilerData data;
+			return CompileNoThrow(data, source, &target, 1, options, &result, nullptr, error);
+		}
+		catch (const std::exception &e)
+		{
+			error.code = ErrorCode::Internal;
+			error.detail = e.what();
+			return false;
+		}
 	}
 }
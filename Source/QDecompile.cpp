@@ -1,39 +1,118 @@
 #include <QScript/QDecompile.h>
+#include <QScript/QTrace.h>
 
 #include <iostream>
 #include <fstream>
 #include <cstdint>
 #include <vector>
+#include <algorithm>
+#include <span>
+#include <string_view>
 #include <stdexcept>
 #include <limits>
 #include <sstream>
 
+#include "QAlloc.h"
 #include "QBinary.h"
+#include "QProbes.h"
 #include "QUtil.h"
 
 namespace QScript
 {
-	// Decompile function
-	std::string Decompile(void *start, void *end)
+	// Decompiler session
+	struct DecompilerData
 	{
-		// Run through file
 		std::stringstream out_stream;
+		std::stringstream line;
 
-		char *p_start = (char*)start;
-		char *p_end = (char *)end;
+		std::vector<std::pair<ptrdiff_t, std::string_view>> labels;
+		std::vector<std::pair<uint32_t, std::string_view>> checksum_strings;
 
-		char *p_token = (char*)start;
+		std::string escaped;
+	};
+
+	Decompiler::Decompiler() : data(new DecompilerData())
+	{
+
+	}
+
+	Decompiler::~Decompiler()
+	{
+
+	}
+
+	// The binary is only read, the binary functions just don't take const pointers
+	static void Decompile(DecompilerData &data, std::span<const std::byte> binary, std::ostream &out_stream, const Symbols &symbols, Stats *stats = nullptr)
+	{
+		QSCRIPT_TRACE_SCOPE("Decompile");
+		QSCRIPT_PROBE1(decompile_begin, binary.size());
+
+		// Run through file
+		char *p_start = (char *)binary.data();
+		char *p_end = p_start + binary.size();
+
+		// Time phases for the stats
+		PhaseTimer timer;
+		if (stats != nullptr)
+		{
+			*stats = Stats();
+			stats->input_bytes = binary.size();
+		}
+
+		char *p_token = p_start;
+
+		// The line is emptied but keeps its buffer, formatting left over from the last run is reset
+		std::stringstream &line = data.line;
+		line.str("");
+		line.clear();
+		line.flags(std::ios_base::dec | std::ios_base::skipws);
+		line.precision(6);
 
-		std::stringstream line;
 		int tab_depth = 0;
 		int pre_tab_depth = 0;
 		int post_tab_depth = 0;
 
 		bool is_arg = false;
 
-		std::unordered_map<ptrdiff_t, std::string> labels = GetLabels(p_start, p_end, p_token);
-		std::unordered_map<uint32_t, std::string> checksum_strings = GetChecksumStrings(p_start, p_end, p_token);
+		auto &labels = data.labels;
+		auto &checksum_strings = data.checksum_strings;
+		GetLabels(p_start, p_end, p_token, labels);
+		if (stats != nullptr)
+		{
+			timer.Lap(stats->label_seconds, stats->label_allocations);
+			stats->labels = labels.size();
+		}
+		GetChecksumStrings(p_start, p_end, p_token, checksum_strings);
 
+		auto find_checksum = [&checksum_strings](uint32_t checksum) -> const std::string_view *
+			{
+				auto it = std::lower_bound(checksum_strings.begin(), checksum_strings.end(), checksum, [](const std::pair<uint32_t, std::string_view> &a, uint32_t b) { return a.first < b; });
+				if (it != checksum_strings.end() && it->first == checksum)
+					return &it->second;
+				return nullptr;
+			};
+
+		// Names in the binary take priority over symbols
+		size_t binary_names = checksum_strings.size();
+		for (const auto &symbol : symbols)
+		{
+			auto it = std::lower_bound(checksum_strings.begin(), checksum_strings.begin() + binary_names, symbol.first, [](const std::pair<uint32_t, std::string_view> &a, uint32_t b) { return a.first < b; });
+			if (it == checksum_strings.begin() + binary_names || it->first != symbol.first)
+				checksum_strings.emplace_back(symbol.first, symbol.second);
+		}
+		if (checksum_strings.size() != binary_names)
+			std::sort(checksum_strings.begin(), checksum_strings.end(), [](const std::pair<uint32_t, std::string_view> &a, const std::pair<uint32_t, std::string_view> &b) { return a.first < b.first; });
+		if (stats != nullptr)
+			timer.Lap(stats->checksum_seconds, stats->checksum_allocations);
+
+		auto escape = [&data](std::string_view string) -> const std::string &
+			{
+				data.escaped.clear();
+				EscapeString(string, data.escaped);
+				return data.escaped;
+			};
+
+		QSCRIPT_TRACE_SCOPE("WriteText");
 		while (p_token != nullptr)
 		{
 			// Print address
@@ -46,11 +125,11 @@ namespace QScript
 			// If there's a label here, print
 			{
 				ptrdiff_t address = p_token - p_start;
-				auto it = labels.find(address);
-				if (it != labels.end())
+				auto it = std::lower_bound(labels.begin(), labels.end(), address, [](const std::pair<ptrdiff_t, std::string_view> &a, ptrdiff_t b) { return a.first < b; });
+				if (it != labels.end() && it->first == address)
 				{
 					line << it->second << " ";
-					if (it->second.find("RANDOMEND") != std::string::npos)
+					if (it->second.find("RANDOMEND") != std::string_view::npos)
 						pre_tab_depth--;
 				}
 			}
@@ -60,11 +139,14 @@ namespace QScript
 			{
 				case Token::EndOfFile:
 				case Token::EndOfLine:
+				case Token::EndOfLineNumber:
 					// Process tabs
 					if (pre_tab_depth < -post_tab_depth)
 						tab_depth += pre_tab_depth + post_tab_depth;
 					for (int i = 0; i < tab_depth; ++i)
 						out_stream << "\t";
+					if (stats != nullptr && tab_depth > 0)
+						stats->output_bytes += tab_depth;
 					if (pre_tab_depth > -post_tab_depth)
 						tab_depth += post_tab_depth + pre_tab_depth;
 					post_tab_depth = 0;
@@ -73,7 +155,9 @@ namespace QScript
 						tab_depth = 0;
 
 					// Write line
-					out_stream << line.str() << std::endl;
+					out_stream << line.view() << '\n';
+					if (stats != nullptr)
+						stats->output_bytes += line.view().size() + 1;
 					line.str("");
 					break;
 				case Token::StartStruct:
@@ -141,17 +225,17 @@ namespace QScript
 				{
 					uint32_t checksum = GetUnsignedInteger(p_start, p_end, p_token + 1);
 					
-					auto find = checksum_strings.find(checksum);
-					if (find != checksum_strings.end())
+					const std::string_view *find = find_checksum(checksum);
+					if (find != nullptr)
 					{
 						if (is_arg)
 							line << "<";
 
 						// Check if string contains any non identifier characters
-						if (find->second.empty() || (find->second.front() >= '0' && find->second.front() <= '9') || find->second.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != std::string::npos)
-							line << "%\"" << EscapeString(find->second) << "\"";
+						if (find->empty() || (find->front() >= '0' && find->front() <= '9') || find->find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_") != std::string_view::npos)
+							line << "%\"" << escape(*find) << "\"";
 						else 
-							line << find->second;
+							line << *find;
 
 						if (is_arg)
 							line << ">";
@@ -165,6 +249,9 @@ namespace QScript
 
 						line << "0x" << std::hex << checksum << std::dec;
 						std::cout << "WARNING: Could not find name for checksum 0x" << std::hex << checksum << std::dec << std::endl;
+						QSCRIPT_PROBE2(unresolved_checksum, checksum, p_token - p_start);
+						if (stats != nullptr)
+							stats->unresolved_checksums++;
 
 						if (is_arg)
 							line << ">";
@@ -201,7 +288,7 @@ namespace QScript
 					uint32_t length = GetUnsignedInteger(p_start, p_end, p_token + 1);
 					if (length)
 						length--;
-					line << "\"" << EscapeString(std::string(p_token + 5, length)) << "\" ";
+					line << "\"" << escape(std::string_view(p_token + 5, length)) << "\" ";
 					break;
 				}
 				case Token::LocalString:
@@ -209,7 +296,7 @@ namespace QScript
 					uint32_t length = GetUnsignedInteger(p_start, p_end, p_token + 1);
 					if (length)
 						length--;
-					line << "#\"" << EscapeString(std::string(p_token + 5, length)) << "\" ";
+					line << "#\"" << escape(std::string_view(p_token + 5, length)) << "\" ";
 					break;
 					break;
 				}
@@ -256,12 +343,14 @@ namespace QScript
 				}
 				case Token::KeywordScript:
 				{
+					QSCRIPT_PROBE1(decompile_script_begin, p_token - p_start);
 					line << "SCRIPT ";
 					post_tab_depth++;
 					break;
 				}
 				case Token::KeywordEndScript:
 				{
+					QSCRIPT_PROBE1(decompile_script_end, p_base - p_start);
 					line << "ENDSCRIPT" << std::endl;
 					pre_tab_depth--;
 					break;
@@ -482,6 +571,121 @@ namespace QScript
 			p_token = p_base;
 		}
 
-		return out_stream.str();
+		if (stats != nullptr)
+		{
+			timer.Lap(stats->decompile_seconds, stats->decompile_allocations);
+			CountTokens(p_start, p_end, *stats);
+		}
+		QSCRIPT_PROBE1(decompile_end, binary.size());
+	}
+
+	std::string_view Decompiler::Decompile(std::span<const std::byte> binary, const Symbols &symbols)
+	{
+		data->out_stream.str("");
+		data->out_stream.clear();
+		QScript::Decompile(*data, binary, data->out_stream, symbols);
+		return data->out_stream.view();
+	}
+
+	std::string_view Decompiler::Decompile(void *start, void *end, const Symbols &symbols)
+	{
+		return Decompile(std::span<const std::byte>((const std::byte *)start, (const std::byte *)end), symbols);
+	}
+
+	void Decompiler::Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols)
+	{
+		QScript::Decompile(*data, binary, out, symbols);
+	}
+
+	void Decompiler::Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Stats &stats)
+	{
+		QScript::Decompile(*data, binary, out, symbols, &stats);
+	}
+
+	// Decompiles for the error code functions, where nothing may be thrown
+	static bool DecompileNoThrow(DecompilerData &data, std::span<const std::byte> binary, std::ostream &out_stream, const Symbols &symbols, Error &error) noexcept
+	{
+		if (!CheckBinary(binary, error))
+			return false;
+		try
+		{
+			Decompile(data, binary, out_stream, symbols);
+			return true;
+		}
+		catch (const std::exception &e)
+		{
+			error.code = ErrorCode::Internal;
+			error.detail = e.what();
+			return false;
+		}
+	}
+
+	bool Decompiler::Decompile(std::span<const std::byte> binary, std::string_view &text, const Symbols &symbols, Error &error) noexcept
+	{
+		data->out_stream.str("");
+		data->out_stream.clear();
+		if (!DecompileNoThrow(*data, binary, data->out_stream, symbols, error))
+			return false;
+		text = data->out_stream.view();
+		return true;
+	}
+
+	bool Decompiler::Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Error &error) noexcept
+	{
+		return DecompileNoThrow(*data, binary, out, symbols, error);
+	}
+
+	// Decompile function
+	std::string Decompile(void *start, void *end)
+	{
+		return Decompile(start, end, Symbols());
+	}
+
+	std::string Decompile(void *start, void *end, const Symbols &symbols)
+	{
+		return Decompile(std::span<const std::byte>((const std::byte *)start, (const std::byte *)end), symbols);
+	}
+
+	std::string Decompile(std::span<const std::byte> binary, const Symbols &symbols)
+	{
+		DecompilerData data;
+		Decompile(data, binary, data.out_stream, symbols);
+		return data.out_stream.str();
+	}
+
+	void Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols)
+	{
+		DecompilerData data;
+		Decompile(data, binary, out, symbols);
+	}
+
+	void Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Stats &stats)
+	{
+		DecompilerData data;
+		Decompile(data, binary, out, symbols, &stats);
+	}
+
+	bool Decompile(std::span<const std::byte> binary, std::ostream &out, const Symbols &symbols, Error &error) noexcept
+	{
+		try
+		{
+			DecompilerData data;
+			return DecompileNoThrow(data, binary, out, symbols, error);
+		}
+		catch (const std::exception &e)
+		{
+			error = Error();
+			error.code = ErrorCode::Internal;
+			error.detail = e.what();
+			return false;
+		}
+	}
+
+	// Binary check
+	bool CheckBinary(std::span<const std::byte> binary, Error &error) noexcept
+	{
+		error = Error();
+		char *p_start = (char *)binary.data();
+		return CheckBinary(p_start, p_start + binary.size(), error);
 	}
 }
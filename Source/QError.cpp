@@ -0,0 +1,120 @@
+#include <QScript/QError.h>
+
+namespace QScript
+{
+	const char *Error::Description() const noexcept
+	{
+		switch (code)
+		{
+			case ErrorCode::None:
+				return "No error";
+			case ErrorCode::UnexpectedEndOfFile:
+				return "Unexpected end of file";
+			case ErrorCode::UnrecognizedToken:
+				return "Unrecognized script token";
+			case ErrorCode::JumpOutOfRange:
+				return "Jump out of range";
+			case ErrorCode::JumpIntoToken:
+				return "Jump into the middle of a token";
+			case ErrorCode::UnmatchedElse:
+				return "'ELSE' outside of an 'IF'";
+			case ErrorCode::UnmatchedEndIf:
+				return "'ENDIF' outside of an 'IF'";
+			case ErrorCode::UnmatchedCase:
+				return "'CASE' or 'DEFAULT' outside of a 'SWITCH'";
+			case ErrorCode::UnmatchedEndSwitch:
+				return "'ENDSWITCH' outside of a 'SWITCH'";
+			case ErrorCode::UnclosedIf:
+				return "'IF' without 'ENDIF'";
+			case ErrorCode::UnclosedSwitch:
+				return "'SWITCH' without 'ENDSWITCH'";
+			case ErrorCode::BadRandom:
+				return "Inconsistent RANDOM jump table";
+			case ErrorCode::DataAfterEndOfFile:
+				return "Data after end of file";
+			case ErrorCode::UnrecognizedCharacter:
+				return "Unrecognized character";
+			case ErrorCode::UnexpectedEndOfScript:
+				return "Unexpected end of script";
+			case ErrorCode::ExpectedNumber:
+				return "Expected integer or float";
+			case ErrorCode::ExpectedOpenParenth:
+				return "Expected '('";
+			case ErrorCode::ExpectedComma:
+				return "Expected ','";
+			case ErrorCode::ExpectedCloseParenth:
+				return "Expected ')'";
+			case ErrorCode::ExpectedCommaOrCloseParenth:
+				return "Expected ',' or ')'";
+			case ErrorCode::UnexpectedEndSwitch:
+				return "Unexpected 'ENDSWITCH' (no 'SWITCH')";
+			case ErrorCode::UnexpectedCase:
+				return "Unexpected 'CASE' or 'DEFAULT' (no 'SWITCH')";
+			case ErrorCode::UnexpectedElse:
+				return "Unexpected 'ELSE' (no 'IF')";
+			case ErrorCode::UnexpectedEndIf:
+				return "Unexpected 'ENDIF' (no 'IF' or 'ELSE')";
+			case ErrorCode::UnexpectedRandomCase:
+				return "Unexpected 'RANDOMCASE' (no random)";
+			case ErrorCode::TooManyRandomCases:
+				return "Unexpected 'RANDOMCASE' (more cases than weights)";
+			case ErrorCode::UnexpectedRandomEnd:
+				return "Unexpected 'RANDOMEND' (no random)";
+			case ErrorCode::IncompleteRandom:
+				return "Unexpected 'RANDOMEND' (random was incomplete)";
+			case ErrorCode::MissingEndSwitch:
+				return "Unexpected end of script (missing 'ENDSWITCH')";
+			case ErrorCode::MissingRandomEnd:
+				return "Unexpected end of script (missing 'RANDOMEND')";
+			case ErrorCode::MissingEndIf:
+				return "Unexpected end of script (missing 'ENDIF')";
+			case ErrorCode::ChecksumCollision:
+				return "Checksum collision";
+			case ErrorCode::Internal:
+				return "Internal error";
+		}
+		return "Unknown error";
+	}
+
+	std::string Error::Message() const
+	{
+		std::string message = Description();
+		switch (code)
+		{
+			case ErrorCode::None:
+				break;
+			case ErrorCode::UnexpectedEndOfFile:
+			case ErrorCode::JumpOutOfRange:
+			case ErrorCode::JumpIntoToken:
+			case ErrorCode::UnmatchedElse:
+			case ErrorCode::UnmatchedEndIf:
+			case ErrorCode::UnmatchedCase:
+			case ErrorCode::UnmatchedEndSwitch:
+			case ErrorCode::UnclosedIf:
+			case ErrorCode::UnclosedSwitch:
+			case ErrorCode::BadRandom:
+			case ErrorCode::DataAfterEndOfFile:
+				if (!detail.empty())
+					message += " (" + detail + ")";
+				message += " at " + std::to_string(offset);
+				break;
+			case ErrorCode::UnrecognizedToken:
+				message += " " + std::to_string(value) + " at " + std::to_string(offset);
+				break;
+			case ErrorCode::UnrecognizedCharacter:
+				message += std::string(" [") + (char)value + "] at line " + std::to_string(line);
+				break;
+			case ErrorCode::Internal:
+				if (!detail.empty())
+					message += " (" + detail + ")";
+				break;
+			default:
+				if (!detail.empty())
+					message += " (" + detail + ")";
+				if (line != 0)
+					message += " at line " + std::to_string(line) + ", column " + std::to_string(column);
+				break;
+		}
+		return message;
+	}
+}
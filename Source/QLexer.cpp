@@ -1,7 +1,211 @@
 #include "QLexer.h"
 
+#include <QScript/QTrace.h>
+
+#define YY_NO_UNISTD_H
+#include <Lexical/Lexical.h>
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
 namespace QScript
 {
-	// QLexer globals
-	std::list<std::unique_ptr<TokenBase>> g_tokens;
+	// Lexes a run of source into the state, which holds the position it starts at
+	void LexRun(const char *text, size_t length, LexerState &state)
+	{
+		QSCRIPT_TRACE_SCOPE("Lex");
+
+		yyscan_t scanner;
+		if (qscript_lex_lex_init_extra(&state, &scanner) != 0)
+			throw std::runtime_error("Failed to initialize lexer");
+
+		// Flex scans in place in a buffer ending with two nulls, the state keeps it between runs
+		state.buffer.assign(text, text + length);
+		state.buffer.push_back('\0');
+		state.buffer.push_back('\0');
+		if (qscript_lex__scan_buffer(state.buffer.data(), state.buffer.size(), scanner) == nullptr)
+		{
+			qscript_lex_lex_destroy(scanner);
+			throw std::runtime_error("Failed to initialize lexer");
+		}
+		qscript_lex_set_lineno(state.line, scanner);
+		while (qscript_lex_lex(scanner)) {}
+		qscript_lex_lex_destroy(scanner);
+	}
+
+	// Matches \"([^\\\"]|\\.)*\", returns the end of the string or 0
+	static size_t MatchString(const char *text, size_t length, size_t i)
+	{
+		for (size_t k = i + 1; k < length;)
+		{
+			if (text[k] == '"')
+				return k + 1;
+			if (text[k] == '\\')
+			{
+				if (k + 1 >= length || text[k + 1] == '\n')
+					return 0;
+				k += 2;
+			}
+			else
+			{
+				k++;
+			}
+		}
+		return 0;
+	}
+
+	// Matches "/*"([^*]|[*][^/])*[*]?"/", returns the end of the longest match or 0
+	// Without a closing "*/", the comment runs to the last slash it can reach
+	static size_t MatchComment(const char *text, size_t length, size_t i)
+	{
+		size_t end = 0;
+		for (size_t k = i + 2; k < length;)
+		{
+			if (text[k] == '*')
+			{
+				if (k + 1 >= length)
+					break;
+				if (text[k + 1] == '/')
+					return k + 2;
+				k += 2;
+			}
+			else
+			{
+				if (text[k] == '/')
+					end = k + 1;
+				k++;
+			}
+		}
+		return end;
+	}
+
+	// Finds line starts to split lexing at
+	// Strings and C-style comments are the only tokens that can span lines, so any other newline ends a token
+	std::vector<size_t> FindSplitPoints(const char *text, size_t length, size_t min_length)
+	{
+		std::vector<size_t> splits;
+		size_t last = 0;
+		for (size_t i = 0; i < length;)
+		{
+			char c = text[i];
+			if (c == '"')
+			{
+				// The lexer stops at a string that doesn't end
+				size_t end = MatchString(text, length, i);
+				if (end == 0)
+					break;
+				i = end;
+			}
+			else if (c == '/' && i + 1 < length && text[i + 1] == '/')
+			{
+				while (i < length && text[i] != '\n')
+					i++;
+			}
+			else if (c == '/' && i + 1 < length && text[i + 1] == '*')
+			{
+				size_t end = MatchComment(text, length, i);
+				i = (end != 0) ? end : (i + 1);
+			}
+			else
+			{
+				i++;
+				if (c == '\n' && i < length && i - last >= min_length)
+				{
+					splits.push_back(i);
+					last = i;
+				}
+			}
+		}
+		return splits;
+	}
+
+	// Lexer functions
+	size_t SourceLength(std::string_view source)
+	{
+		size_t length = source.find('\0');
+		return length != std::string_view::npos ? length : source.size();
+	}
+
+	void Lex(std::string_view source, LexerState &state)
+	{
+		LexRun(source.data(), SourceLength(source), state);
+	}
+
+	void LexParallel(std::string_view source, unsigned int threads, LexerState &state)
+	{
+		if (threads == 0)
+			threads = std::thread::hardware_concurrency();
+
+		const char *text = source.data();
+		size_t length = SourceLength(source);
+
+		std::vector<size_t> splits;
+		if (threads >= 2)
+			splits = FindSplitPoints(text, length, length / threads + 1);
+		if (splits.empty())
+		{
+			Lex(source, state);
+			return;
+		}
+		splits.insert(splits.begin(), 0);
+		splits.push_back(length);
+
+		// Each run starts at the start of a line
+		size_t runs = splits.size() - 1;
+		if (state.runs.size() < runs)
+			state.runs.resize(runs);
+		auto &states = state.runs;
+		for (size_t i = 0; i < runs; i++)
+			states[i].Reset();
+		for (size_t i = 1; i < runs; i++)
+		{
+			states[i].line = states[i - 1].line + (int)std::count(text + splits[i - 1], text + splits[i], '\n');
+			states[i].token_line = states[i].line;
+		}
+
+		// Lex runs
+		std::vector<std::thread> workers;
+		std::vector<std::exception_ptr> exceptions(runs);
+		workers.reserve(runs);
+		for (size_t i = 0; i < runs; i++)
+		{
+			workers.emplace_back([&, i]()
+				{
+					try
+					{
+						LexRun(text + splits[i], splits[i + 1] - splits[i], states[i]);
+					}
+					catch (...)
+					{
+						exceptions[i] = std::current_exception();
+					}
+				});
+		}
+		for (auto &worker : workers)
+			worker.join();
+
+		for (const auto &exception : exceptions)
+		{
+			if (exception)
+				std::rethrow_exception(exception);
+		}
+
+		// Stitch runs together, stopping where the lexer would have stopped
+		for (size_t i = 0; i < runs; i++)
+		{
+			const auto &run = states[i];
+			state.tokens.insert(state.tokens.end(), run.tokens.begin(), run.tokens.end());
+			state.line = run.line;
+			state.column = run.column;
+			state.token_line = run.token_line;
+			state.token_column = run.token_column;
+			if (run.error)
+			{
+				state.error = run.error;
+				break;
+			}
+		}
+	}
 }
@@ -1,13 +1,19 @@
 #pragma once
 
-#include <list>
+#include <cstddef>
 #include <memory>
+#include <new>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <cstring>
 #include <iostream>
 
+#include <QScript/QError.h>
+
 #include "QToken.h"
 
 namespace QScript
@@ -16,8 +22,10 @@ namespace QScript
 	struct TokenBase
 	{
 		Token type;
+		int line = 0, column = 0;
 
 		TokenBase(Token _type) : type(_type) {}
+		virtual ~TokenBase() = default;
 
 		protected:
 			static int ctoi(char c)
@@ -31,9 +39,12 @@ namespace QScript
 
 	struct TokenString : public TokenBase
 	{
-		std::string value;
+		std::string_view value; // Null terminated, held by the lexer's token arena
+
+		TokenString(Token _type, std::string_view _value) : TokenBase(_type), value(_value) {}
 
-		TokenString(Token _type, const char *_str, int substart, int subend) : TokenBase(_type)
+		// Decodes a matched string into a value, cutting it down to its contents and handling escape sequences
+		static void Decode(std::string &value, const char *_str, int substart, int subend)
 		{
 			// Get string start and end
 			const char *qstart = _str;
@@ -325,6 +336,186 @@ namespace QScript
 		}
 	};
 
-	// QScript globals
-	extern std::list<std::unique_ptr<TokenBase>> g_tokens;
+	// Token storage
+	// Blocks are kept when the arena is reset, so lexing into a used arena doesn't allocate for tokens
+	class TokenArena
+	{
+		private:
+			static constexpr size_t BLOCK_SIZE = 0x10000;
+
+			std::vector<std::unique_ptr<unsigned char[]>> blocks;
+			size_t block = 0, used = 0;
+			std::vector<TokenBase*> objects;
+
+			// Text too big for a block, these are freed on reset
+			std::vector<std::unique_ptr<char[]>> large_texts;
+
+			// Finds room in the blocks, moving to the next block if this one is full
+			unsigned char *Allocate(size_t size, size_t alignment)
+			{
+				size_t offset = (used + alignment - 1) & ~(alignment - 1);
+				if (block >= blocks.size() || offset + size > BLOCK_SIZE)
+				{
+					if (block < blocks.size())
+						block++;
+					if (block >= blocks.size())
+						blocks.emplace_back(new unsigned char[BLOCK_SIZE]);
+					offset = 0;
+				}
+				used = offset + size;
+				return blocks[block].get() + offset;
+			}
+
+		public:
+			TokenArena() = default;
+			TokenArena(TokenArena &&) = default;
+			TokenArena &operator=(TokenArena &&) = delete;
+			~TokenArena() { Reset(); }
+
+			template<typename T, typename... Args>
+			T *New(Args&&... args)
+			{
+				static_assert(sizeof(T) <= BLOCK_SIZE);
+
+				T *object = new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+				objects.push_back(object);
+				return object;
+			}
+
+			// Copies text into the arena with a null terminator
+			std::string_view NewText(std::string_view text)
+			{
+				char *copy;
+				if (text.size() + 1 > BLOCK_SIZE)
+				{
+					large_texts.emplace_back(new char[text.size() + 1]);
+					copy = large_texts.back().get();
+				}
+				else
+				{
+					copy = (char *)Allocate(text.size() + 1, 1);
+				}
+				std::memcpy(copy, text.data(), text.size());
+				copy[text.size()] = '\0';
+				return std::string_view(copy, text.size());
+			}
+
+			// Bytes held by the blocks
+			size_t Capacity() const
+			{
+				return blocks.size() * BLOCK_SIZE;
+			}
+
+			void Reset()
+			{
+				for (auto &object : objects)
+					object->~TokenBase();
+				objects.clear();
+				large_texts.clear();
+				block = 0;
+				used = 0;
+			}
+	};
+
+	// Lexer state
+	struct LexerState
+	{
+		std::vector<TokenBase*> tokens;
+		TokenArena arena;
+
+		// Position after the last match, and of the last match
+		int line = 1, column = 1;
+		int token_line = 1, token_column = 1;
+
+		void Advance(const char *text, size_t length)
+		{
+			token_line = line;
+			token_column = column;
+			for (size_t i = 0; i < length; i++)
+			{
+				if (text[i] == '\n')
+				{
+					line++;
+					column = 1;
+				}
+				else
+				{
+					column++;
+				}
+			}
+		}
+
+		template<typename T, typename... Args>
+		void Push(Args&&... args)
+		{
+			// Strings are decoded into scratch and copied into the arena, so the token holds no allocation of its own
+			TokenBase *token;
+			if constexpr (std::is_same_v<T, TokenString>)
+				token = NewString(std::forward<Args>(args)...);
+			else
+				token = arena.New<T>(std::forward<Args>(args)...);
+			token->line = token_line;
+			token->column = token_column;
+			tokens.push_back(token);
+		}
+
+		std::string scratch;
+
+		TokenString *NewString(Token type, const char *str, int substart, int subend)
+		{
+			scratch.clear();
+			TokenString::Decode(scratch, str, substart, subend);
+			return arena.New<TokenString>(type, arena.NewText(scratch));
+		}
+
+		// Lexing stops at an unrecognized character
+		Error error;
+
+		void Unrecognized(char c, int line_number)
+		{
+			error.code = ErrorCode::UnrecognizedCharacter;
+			error.value = (unsigned char)c;
+			error.line = line_number;
+			error.column = token_column;
+		}
+
+		// Runs lexed in parallel, tokens of the state point into their arenas
+		std::vector<LexerState> runs;
+
+		// Copy of the source being scanned
+		std::vector<char> buffer;
+
+		// Bytes held by the tokens of the state and its runs
+		size_t TokenBytes() const
+		{
+			size_t bytes = arena.Capacity() + tokens.capacity() * sizeof(TokenBase*);
+			for (const auto &run : runs)
+				bytes += run.TokenBytes();
+			return bytes;
+		}
+
+		// Clears the state for another source, keeping its storage
+		void Reset()
+		{
+			tokens.clear();
+			arena.Reset();
+			for (auto &run : runs)
+				run.Reset();
+			line = column = 1;
+			token_line = token_column = 1;
+			error = Error();
+		}
+	};
+
+	// Lexer functions
+	// Source ends at the first null, if there is one
+	// Lexing stops at an unrecognized character, which is left in the state's error
+	size_t SourceLength(std::string_view source);
+
+	void Lex(std::string_view source, LexerState &state);
+	void LexParallel(std::string_view source, unsigned int threads, LexerState &state);
+
+	// Runs of source can be lexed on their own when they start and end at split points
+	std::vector<size_t> FindSplitPoints(const char *text, size_t length, size_t min_length);
+	void LexRun(const char *text, size_t length, LexerState &state);
 }
@@ -0,0 +1,123 @@
+#include <QScript/QLink.h>
+
+#include "QBinary.h"
+#include "QUtil.h"
+
+#include <stdexcept>
+#include <unordered_map>
+
+namespace QScript
+{
+	// Link function
+	void Link(const std::vector<CompileResult> &units, CompileResult &result)
+	{
+		std::vector<unsigned char> &bytecode = result.bytecode;
+		bytecode.clear();
+		result.symbols.clear();
+		result.source_map = SourceMap();
+
+		// Checksum names in order of first appearance
+		std::unordered_map<uint32_t, std::string> checksums;
+		std::vector<uint32_t> checksum_order;
+
+		auto add_checksum = [&checksums](uint32_t crc, const std::string &name) -> bool
+			{
+				auto find = checksums.find(crc);
+				if (find != checksums.end())
+				{
+					// Check if there's a collision
+					if (!SimpleStringEqual(find->second, name))
+						throw std::runtime_error("Checksum collision (" + find->second + " == " + name + ")");
+					return false;
+				}
+				checksums[crc] = name;
+				return true;
+			};
+
+		bool ends_line = true;
+		for (const auto &unit : units)
+		{
+			char *p_start = (char *)unit.bytecode.data();
+			char *p_end = p_start + unit.bytecode.size();
+
+			// Find the end of the code
+			char *p_token = p_start;
+			char *p_last = nullptr;
+			while (p_token < p_end && (Token)*p_token != Token::ChecksumName && (Token)*p_token != Token::EndOfFile)
+			{
+				p_last = p_token;
+				p_token = SkipToken(p_start, p_end, p_token);
+			}
+			if (p_token >= p_end)
+				throw std::runtime_error("[Link] Missing end of file");
+
+			// A unit whose code doesn't end its last line would run into the next one
+			if (p_last != nullptr)
+			{
+				if (!ends_line)
+					bytecode.push_back((unsigned char)Token::EndOfLine);
+				ends_line = (Token)*p_last == Token::EndOfLine || (Token)*p_last == Token::EndOfLineNumber;
+			}
+
+			size_t offset = bytecode.size();
+			bytecode.insert(bytecode.end(), p_start, p_token);
+
+			// Read checksum names
+			while ((Token)*p_token == Token::ChecksumName)
+			{
+				uint32_t crc = GetUnsignedInteger(p_start, p_end, p_token + 1);
+				std::string name;
+				for (char *p_name = p_token + 5; p_name < p_end && *p_name; p_name++)
+					name += *p_name;
+
+				if (add_checksum(crc, name))
+					checksum_order.push_back(crc);
+
+				p_token = SkipToken(p_start, p_end, p_token);
+				if (p_token >= p_end)
+					throw std::runtime_error("[Link] Missing end of file");
+			}
+			if ((Token)*p_token != Token::EndOfFile)
+				throw std::runtime_error("[Link] Expected end of file at " + std::to_string(p_token - p_start));
+
+			// Merge stripped symbols
+			for (const auto &symbol : unit.symbols)
+			{
+				auto find_symbol = result.symbols.find(symbol.first);
+				if (find_symbol != result.symbols.end() && !SimpleStringEqual(find_symbol->second, symbol.second))
+					throw std::runtime_error("Checksum collision (" + find_symbol->second + " == " + symbol.second + ")");
+				result.symbols[symbol.first] = symbol.second;
+			}
+
+			// Merge source map
+			uint32_t file_offset = (uint32_t)result.source_map.files.size();
+			result.source_map.files.insert(result.source_map.files.end(), unit.source_map.files.begin(), unit.source_map.files.end());
+			for (const auto &entry : unit.source_map.entries)
+				result.source_map.entries.push_back(SourceMapEntry{ entry.offset + (uint32_t)offset, entry.file + file_offset, entry.line, entry.column });
+		}
+
+		// Stripped names must agree with the names still in the table
+		for (const auto &symbol : result.symbols)
+		{
+			auto find = checksums.find(symbol.first);
+			if (find != checksums.end() && !SimpleStringEqual(find->second, symbol.second))
+				throw std::runtime_error("Checksum collision (" + find->second + " == " + symbol.second + ")");
+		}
+
+		// Write out checksums
+		for (const auto &crc : checksum_order)
+		{
+			const std::string &name = checksums[crc];
+			bytecode.push_back((unsigned char)Token::ChecksumName);
+			bytecode.push_back((unsigned char)((crc >> 0) & 0xFF));
+			bytecode.push_back((unsigned char)((crc >> 8) & 0xFF));
+			bytecode.push_back((unsigned char)((crc >> 16) & 0xFF));
+			bytecode.push_back((unsigned char)((crc >> 24) & 0xFF));
+			bytecode.insert(bytecode.end(), name.begin(), name.end());
+			bytecode.push_back(0);
+		}
+
+		// Terminate bytecode
+		bytecode.push_back((unsigned char)Token::EndOfFile);
+	}
+}
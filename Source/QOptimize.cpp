@@ -0,0 +1,390 @@
+#include "QOptimize.h"
+
+#include "QBinary.h"
+#include "QRewrite.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+namespace QScript
+{
+	// Tokens the interpreter steps over without affecting control flow
+	static bool IsNoOp(Token token)
+	{
+		switch (token)
+		{
+			case Token::EndOfLine:
+			case Token::EndOfLineNumber:
+			case Token::KeywordEndIf:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	// Tokens that end a line
+	static bool IsEndOfLine(Token token)
+	{
+		return token == Token::EndOfLine || token == Token::EndOfLineNumber;
+	}
+
+	// Tokens that never transfer control
+	static bool IsStraightLine(Token token)
+	{
+		switch (token)
+		{
+			case Token::EndOfLine:
+			case Token::EndOfLineNumber:
+			case Token::StartStruct:
+			case Token::EndStruct:
+			case Token::StartArray:
+			case Token::EndArray:
+			case Token::Equals:
+			case Token::Dot:
+			case Token::Comma:
+			case Token::Minus:
+			case Token::Add:
+			case Token::Divide:
+			case Token::Multiply:
+			case Token::OpenParenth:
+			case Token::CloseParenth:
+			case Token::SameAs:
+			case Token::LessThan:
+			case Token::LessThanEqual:
+			case Token::GreaterThan:
+			case Token::GreaterThanEqual:
+			case Token::Name:
+			case Token::Integer:
+			case Token::HexInteger:
+			case Token::Float:
+			case Token::String:
+			case Token::LocalString:
+			case Token::Vector:
+			case Token::Pair:
+			case Token::KeywordReturn:
+			case Token::KeywordAllArgs:
+			case Token::Arg:
+			case Token::Or:
+			case Token::And:
+			case Token::Xor:
+			case Token::ShiftLeft:
+			case Token::ShiftRight:
+			case Token::KeywordRandomRange:
+			case Token::KeywordRandomRange2:
+			case Token::KeywordNot:
+			case Token::KeywordAnd:
+			case Token::KeywordOr:
+			case Token::Colon:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	// Branch optimization pass
+	void OptimizeBranches(std::vector<unsigned char> &bytecode, std::vector<size_t> *addresses)
+	{
+		for (int pass = 0; pass < 16; pass++)
+		{
+			bool changed = false;
+
+			// Analyze bytecode
+			std::vector<size_t> tokens = GetTokenAddresses(bytecode, 0, bytecode.size());
+			std::vector<Relocation> relocations = GetRelocations(bytecode, tokens);
+
+			auto token_at = [&bytecode](size_t address) -> Token
+				{
+					return (Token)bytecode[address];
+				};
+
+			auto token_index = [&tokens](size_t address) -> size_t
+				{
+					return std::lower_bound(tokens.begin(), tokens.end(), address) - tokens.begin();
+				};
+
+			auto token_end = [&tokens, &bytecode](size_t index) -> size_t
+				{
+					return (index + 1 < tokens.size()) ? tokens[index + 1] : bytecode.size();
+				};
+
+			std::unordered_map<size_t, size_t> relocation_fields;
+			for (size_t i = 0; i < relocations.size(); i++)
+				relocation_fields[relocations[i].field] = i;
+
+			// Thread jumps that land on unconditional jumps
+			// Only IF, ELSE and CASE jumps are threaded, RANDOM jumps mark where their cases start and end
+			for (auto &relocation : relocations)
+			{
+				if (!relocation.is_short)
+					continue;
+
+				size_t target = relocation.target;
+				for (int hops = 0; hops < 32; hops++)
+				{
+					// Step over tokens that do nothing
+					size_t index = token_index(target);
+					if (index >= tokens.size() || tokens[index] != target)
+						break;
+					while (index < tokens.size() && IsNoOp(token_at(tokens[index])))
+						index++;
+					if (index >= tokens.size())
+						break;
+
+					// Check for an unconditional jump, ShortJumps belonging to a case are conditional
+					size_t address = tokens[index];
+					Token token = token_at(address);
+					if (token != Token::FastElse && token != Token::ShortJump)
+						break;
+					if (token == Token::ShortJump && index > 0 && (token_at(tokens[index - 1]) == Token::KeywordCase || token_at(tokens[index - 1]) == Token::KeywordDefault))
+						break;
+					if (address + 1 == relocation.field)
+						break;
+
+					target = relocations[relocation_fields.at(address + 1)].target;
+				}
+
+				if (target == relocation.target)
+					continue;
+				ptrdiff_t relative = (ptrdiff_t)target - (ptrdiff_t)relocation.field;
+				if (relative < -0x8000 || relative > 0x7FFF)
+					continue;
+
+				relocation.target = target;
+				WriteRelocation(bytecode, relocation);
+				changed = true;
+			}
+
+			// Match IF, ELSE and ENDIF
+			struct IfBlock
+			{
+				size_t address = 0;
+				size_t else_address = (size_t)-1;
+				size_t endif_address = (size_t)-1;
+			};
+			std::vector<IfBlock> if_blocks;
+			{
+				std::vector<size_t> if_stack;
+				for (const auto &address : tokens)
+				{
+					switch (token_at(address))
+					{
+						case Token::FastIf:
+						case Token::KeywordIf:
+							if_stack.push_back(if_blocks.size());
+							if_blocks.push_back(IfBlock{ address });
+							break;
+						case Token::FastElse:
+						case Token::KeywordElse:
+							if (!if_stack.empty())
+								if_blocks[if_stack.back()].else_address = address;
+							break;
+						case Token::KeywordEndIf:
+							if (!if_stack.empty())
+							{
+								if_blocks[if_stack.back()].endif_address = address;
+								if_stack.pop_back();
+							}
+							break;
+						default:
+							break;
+					}
+				}
+			}
+
+			// Jump targets, sorted
+			std::vector<std::pair<size_t, size_t>> targets; // target, field
+			targets.reserve(relocations.size());
+			for (const auto &relocation : relocations)
+				targets.emplace_back(relocation.target, relocation.field);
+			std::sort(targets.begin(), targets.end());
+
+			auto is_target = [&targets](size_t address) -> bool
+				{
+					auto it = std::lower_bound(targets.begin(), targets.end(), std::make_pair(address, (size_t)0));
+					return it != targets.end() && it->first == address;
+				};
+
+			// Check that a set of ranges can be removed
+			// Jumps from outside may only land on trailing tokens that do nothing
+			auto is_closed = [&](size_t start, size_t end, std::initializer_list<std::pair<size_t, size_t>> ranges) -> bool
+				{
+					auto it = std::upper_bound(targets.begin(), targets.end(), std::make_pair(start, (size_t)-1));
+					for (; it != targets.end() && it->first < end; ++it)
+					{
+						size_t field = it->second;
+						if (std::any_of(ranges.begin(), ranges.end(), [field](const std::pair<size_t, size_t> &range) { return field >= range.first && field < range.second; }))
+							continue;
+						for (size_t index = token_index(it->first); index < tokens.size() && tokens[index] < end; index++)
+						{
+							if (!IsNoOp(token_at(tokens[index])))
+								return false;
+						}
+					}
+					return true;
+				};
+
+			// Collect removals
+			std::map<size_t, size_t> removals;
+
+			auto try_remove = [&](std::initializer_list<std::pair<size_t, size_t>> ranges) -> bool
+				{
+					for (const auto &range : ranges)
+					{
+						if (range.first >= range.second)
+							return false;
+						if (!is_closed(range.first, range.second, ranges))
+							return false;
+
+						// Check for overlap with other removals
+						auto it = removals.lower_bound(range.first);
+						if (it != removals.end() && it->first < range.second)
+							return false;
+						if (it != removals.begin() && std::prev(it)->second > range.first)
+							return false;
+					}
+					for (const auto &range : ranges)
+						removals[range.first] = range.second;
+					return true;
+				};
+
+			// Remove IFs on literal conditions
+			for (const auto &block : if_blocks)
+			{
+				if (token_at(block.address) != Token::FastIf || block.endif_address == (size_t)-1)
+					continue;
+
+				// Read literal condition
+				size_t index = token_index(block.address) + 1;
+				bool parenth = false;
+				if (index < tokens.size() && token_at(tokens[index]) == Token::OpenParenth)
+				{
+					parenth = true;
+					index++;
+				}
+				if (index >= tokens.size() || token_at(tokens[index]) != Token::Integer)
+					continue;
+
+				int32_t value = GetSignedInteger((char *)bytecode.data(), (char *)bytecode.data() + bytecode.size(), (char *)bytecode.data() + tokens[index] + 1);
+				index++;
+
+				if (parenth)
+				{
+					if (index >= tokens.size() || token_at(tokens[index]) != Token::CloseParenth)
+						continue;
+					index++;
+				}
+				if (index >= tokens.size() || !IsEndOfLine(token_at(tokens[index])))
+					continue;
+
+				size_t condition_end = tokens[index];
+				size_t endif_end = block.endif_address + 1;
+
+				bool removed;
+				if (value != 0)
+				{
+					// Keep the IF body
+					if (block.else_address != (size_t)-1)
+						removed = try_remove({ { block.address, condition_end }, { block.else_address, endif_end } });
+					else
+						removed = try_remove({ { block.address, condition_end }, { block.endif_address, endif_end } });
+				}
+				else
+				{
+					// Keep the ELSE body
+					if (block.else_address != (size_t)-1)
+						removed = try_remove({ { block.address, block.else_address + 3 }, { block.endif_address, endif_end } });
+					else
+						removed = try_remove({ { block.address, endif_end } });
+				}
+				changed |= removed;
+			}
+
+			// Remove empty ELSE blocks
+			for (const auto &block : if_blocks)
+			{
+				if (block.else_address == (size_t)-1 || block.endif_address == (size_t)-1 || token_at(block.else_address) != Token::FastElse)
+					continue;
+
+				bool empty = true;
+				for (size_t index = token_index(block.else_address) + 1; index < tokens.size() && tokens[index] < block.endif_address; index++)
+				{
+					if (!IsEndOfLine(token_at(tokens[index])))
+					{
+						empty = false;
+						break;
+					}
+				}
+				if (empty)
+					changed |= try_remove({ { block.else_address, block.endif_address } });
+			}
+
+			// Remove unreachable code after RETURN
+			for (size_t i = 0; i < tokens.size(); i++)
+			{
+				if (token_at(tokens[i]) != Token::KeywordReturn)
+					continue;
+
+				// Skip to the end of the line, a struct or array argument can span several lines
+				size_t index = i + 1;
+				int depth = 0;
+				for (; index < tokens.size() && IsStraightLine(token_at(tokens[index])); index++)
+				{
+					Token token = token_at(tokens[index]);
+					if (token == Token::StartStruct || token == Token::StartArray)
+						depth++;
+					else if (token == Token::EndStruct || token == Token::EndArray)
+						depth--;
+					else if (IsEndOfLine(token) && depth <= 0)
+						break;
+				}
+				if (index >= tokens.size() || !IsEndOfLine(token_at(tokens[index])) || depth != 0)
+					continue;
+				index++;
+				if (index >= tokens.size())
+					continue;
+
+				// Find whole lines of straight line code that nothing jumps into, up to the end of the block
+				size_t start = tokens[index];
+				size_t end = start;
+				for (; index < tokens.size(); index++)
+				{
+					size_t address = tokens[index];
+					Token token = token_at(address);
+					if (is_target(address) || !IsStraightLine(token))
+						break;
+
+					if (token == Token::StartStruct || token == Token::StartArray)
+						depth++;
+					else if (token == Token::EndStruct || token == Token::EndArray)
+						depth--;
+					else if (IsEndOfLine(token) && depth == 0)
+						end = token_end(index);
+					if (depth < 0)
+						break;
+				}
+
+				if (end > start)
+					changed |= try_remove({ { start, end } });
+			}
+
+			// Collapse repeated end of lines left behind by removals
+			// End of lines that are jumped to are kept, RANDOMEND relies on them
+			for (size_t i = 0; i + 1 < tokens.size(); i++)
+			{
+				if (IsEndOfLine(token_at(tokens[i])) && IsEndOfLine(token_at(tokens[i + 1])) && !is_target(tokens[i + 1]))
+					changed |= try_remove({ { tokens[i + 1], token_end(i + 1) } });
+			}
+
+			// Apply removals
+			std::vector<Edit> edits;
+			edits.reserve(removals.size());
+			for (const auto &removal : removals)
+				edits.push_back(Edit{ removal.first, removal.second - removal.first, {} });
+			ApplyEdits(bytecode, relocations, std::move(edits), addresses);
+
+			if (!changed)
+				break;
+		}
+	}
+}
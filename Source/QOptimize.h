@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace QScript
+{
+	// Branch optimization pass
+	// Threads jumps to jumps, removes IFs on literal conditions, unreachable code after RETURN and empty ELSE blocks
+	// Addresses are kept pointing at the same code as it moves
+	void OptimizeBranches(std::vector<unsigned char> &bytecode, std::vector<size_t> *addresses = nullptr);
+}
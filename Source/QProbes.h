@@ -0,0 +1,26 @@
+#pragma once
+
+// Static probes
+// Built in when QSCRIPT_PROBES is defined, each probe is then a nop with a note that perf and bpftrace can attach to
+// Otherwise the probes and their arguments compile away
+//
+// Provider qscript:
+//   compile_begin(source bytes, targets)
+//   compile_end(bytecode bytes of the first target, succeeded), fired when a compile returns
+//   compile_script_begin(bytecode offset, line), compile_script_end(bytecode offset, line)
+//     Offsets are within the run being emitted, which is only the whole file for serial compiles
+//   checksum_collision(checksum, first name, second name)
+//   decompile_begin(binary bytes), decompile_end(binary bytes)
+//   decompile_script_begin(binary offset), decompile_script_end(binary offset)
+//   unresolved_checksum(checksum, binary offset)
+#ifdef QSCRIPT_PROBES
+#include <sys/sdt.h>
+
+#define QSCRIPT_PROBE1(name, a) DTRACE_PROBE1(qscript, name, a)
+#define QSCRIPT_PROBE2(name, a, b) DTRACE_PROBE2(qscript, name, a, b)
+#define QSCRIPT_PROBE3(name, a, b, c) DTRACE_PROBE3(qscript, name, a, b, c)
+#else
+#define QSCRIPT_PROBE1(name, a) ((void)0)
+#define QSCRIPT_PROBE2(name, a, b) ((void)0)
+#define QSCRIPT_PROBE3(name, a, b, c) ((void)0)
+#endif
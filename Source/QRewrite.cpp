@@ -0,0 +1,169 @@
+#include "QRewrite.h"
+
+#include "QBinary.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace QScript
+{
+	std::vector<size_t> GetTokenAddresses(std::vector<unsigned char> &bytecode, size_t start, size_t end)
+	{
+		char *p_start = (char *)bytecode.data();
+		char *p_end = p_start + end;
+
+		std::vector<size_t> tokens;
+		char *p_token = p_start + start;
+		while (p_token != nullptr && p_token < p_end)
+		{
+			// Stop at the checksum table
+			if ((Token)*p_token == Token::ChecksumName)
+				break;
+
+			tokens.push_back(p_token - p_start);
+			p_token = SkipToken(p_start, p_end, p_token);
+		}
+		return tokens;
+	}
+
+	std::vector<Relocation> GetRelocations(std::vector<unsigned char> &bytecode, const std::vector<size_t> &tokens)
+	{
+		char *p_start = (char *)bytecode.data();
+		char *p_end = p_start + bytecode.size();
+
+		std::vector<Relocation> relocations;
+		for (const auto &address : tokens)
+		{
+			char *p_token = p_start + address;
+			switch ((Token)*p_token)
+			{
+				case Token::FastIf:
+				case Token::FastElse:
+				case Token::ShortJump:
+				{
+					relocations.push_back(Relocation{ address + 1, (size_t)GetShortAddress_Relative(p_start, p_end, p_token + 1), true });
+					break;
+				}
+				case Token::Jump:
+				{
+					relocations.push_back(Relocation{ address + 1, (size_t)GetAddress_Relative(p_start, p_end, p_token + 1), false });
+					break;
+				}
+				case Token::KeywordRandom:
+				case Token::KeywordRandom2:
+				case Token::KeywordRandomNoRepeat:
+				case Token::KeywordRandomPermute:
+				{
+					uint32_t num_jumps = GetUnsignedInteger(p_start, p_end, p_token + 1);
+					for (uint32_t i = 0; i < num_jumps; i++)
+					{
+						size_t field = address + 5 + 2 * num_jumps + 4 * i;
+						relocations.push_back(Relocation{ field, (size_t)GetAddress_Relative(p_start, p_end, p_start + field), false });
+					}
+					break;
+				}
+				default:
+					break;
+			}
+		}
+		return relocations;
+	}
+
+	void WriteRelocation(std::vector<unsigned char> &bytecode, const Relocation &relocation)
+	{
+		if (relocation.is_short)
+		{
+			ptrdiff_t relative = (ptrdiff_t)relocation.target - (ptrdiff_t)relocation.field;
+			if (relative < -0x8000 || relative > 0x7FFF)
+				throw std::runtime_error("Short jump out of range (" + std::to_string(relative) + " bytes at " + std::to_string(relocation.field) + ")");
+			bytecode.at(relocation.field + 0) = (unsigned char)((relative >> 0) & 0xFF);
+			bytecode.at(relocation.field + 1) = (unsigned char)((relative >> 8) & 0xFF);
+		}
+		else
+		{
+			ptrdiff_t relative = (ptrdiff_t)relocation.target - (ptrdiff_t)(relocation.field + 4);
+			bytecode.at(relocation.field + 0) = (unsigned char)((relative >> 0) & 0xFF);
+			bytecode.at(relocation.field + 1) = (unsigned char)((relative >> 8) & 0xFF);
+			bytecode.at(relocation.field + 2) = (unsigned char)((relative >> 16) & 0xFF);
+			bytecode.at(relocation.field + 3) = (unsigned char)((relative >> 24) & 0xFF);
+		}
+	}
+
+	void ApplyEdits(std::vector<unsigned char> &bytecode, std::vector<Relocation> &relocations, std::vector<Edit> edits, std::vector<size_t> *addresses)
+	{
+		if (edits.empty())
+			return;
+
+		// Sort edits and check that they don't overlap
+		std::sort(edits.begin(), edits.end(), [](const Edit &a, const Edit &b) { return a.address < b.address; });
+		for (size_t i = 1; i < edits.size(); i++)
+		{
+			if (edits[i].address < edits[i - 1].address + edits[i - 1].size)
+				throw std::runtime_error("[ApplyEdits] Overlapping edits at " + std::to_string(edits[i].address));
+		}
+
+		// Build new bytecode, remembering where each edit was moved to
+		std::vector<unsigned char> result;
+		result.reserve(bytecode.size());
+
+		std::vector<size_t> new_addresses;
+		new_addresses.reserve(edits.size());
+
+		size_t copied = 0;
+		for (const auto &edit : edits)
+		{
+			result.insert(result.end(), bytecode.begin() + copied, bytecode.begin() + edit.address);
+			new_addresses.push_back(result.size());
+			result.insert(result.end(), edit.bytes.begin(), edit.bytes.end());
+			copied = edit.address + edit.size;
+		}
+		result.insert(result.end(), bytecode.begin() + copied, bytecode.end());
+
+		// Address remapping
+		// Addresses inside of an edited range are moved to the end of the replacement
+		auto find_edit = [&edits](size_t address) -> ptrdiff_t
+			{
+				auto it = std::upper_bound(edits.begin(), edits.end(), address, [](size_t a, const Edit &edit) { return a < edit.address; });
+				return (it - edits.begin()) - 1;
+			};
+
+		auto remap = [&edits, &new_addresses, &find_edit](size_t address) -> size_t
+			{
+				ptrdiff_t i = find_edit(address);
+				if (i < 0)
+					return address;
+
+				const auto &edit = edits[i];
+				if (address == edit.address)
+					return new_addresses[i];
+				if (address < edit.address + edit.size)
+					return new_addresses[i] + edit.bytes.size();
+				return address - (edit.address + edit.size) + new_addresses[i] + edit.bytes.size();
+			};
+
+		// Remap relocations, dropping any whose field was edited out
+		std::vector<Relocation> remapped;
+		remapped.reserve(relocations.size());
+		for (const auto &relocation : relocations)
+		{
+			ptrdiff_t i = find_edit(relocation.field);
+			if (i >= 0 && relocation.field < edits[i].address + edits[i].size)
+				continue;
+			remapped.push_back(Relocation{ remap(relocation.field), remap(relocation.target), relocation.is_short });
+		}
+
+		// Remap any other addresses
+		if (addresses != nullptr)
+		{
+			for (auto &address : *addresses)
+				address = remap(address);
+		}
+
+		// Write relocations into the new bytecode
+		bytecode = std::move(result);
+		relocations = std::move(remapped);
+		for (const auto &relocation : relocations)
+			WriteRelocation(bytecode, relocation);
+	}
+}
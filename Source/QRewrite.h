@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace QScript
+{
+	// Relative address field in bytecode
+	struct Relocation
+	{
+		size_t field = 0; // Offset of the address field
+		size_t target = 0; // Absolute address the field points to
+		bool is_short = false; // Short addresses are relative to the field, long addresses are relative to the end of the field
+	};
+
+	// Replacement of a bytecode range
+	struct Edit
+	{
+		size_t address = 0;
+		size_t size = 0;
+		std::vector<unsigned char> bytes;
+	};
+
+	// Bytecode rewriting functions
+	std::vector<size_t> GetTokenAddresses(std::vector<unsigned char> &bytecode, size_t start, size_t end);
+	std::vector<Relocation> GetRelocations(std::vector<unsigned char> &bytecode, const std::vector<size_t> &tokens);
+
+	void WriteRelocation(std::vector<unsigned char> &bytecode, const Relocation &relocation);
+	void ApplyEdits(std::vector<unsigned char> &bytecode, std::vector<Relocation> &relocations, std::vector<Edit> edits, std::vector<size_t> *addresses = nullptr);
+}
@@ -0,0 +1,111 @@
+#include <QScript/QSourceMap.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace QScript
+{
+	// Sidecar layout
+	// "QSM1", file count, NUL terminated file names, entry count, then for each entry
+	// offset delta, file, line delta and column, all as LEB128 with the line delta zigzag encoded
+	static const char s_source_map_magic[4] = { 'Q', 'S', 'M', '1' };
+
+	const SourceMapEntry *SourceMap::Find(uint32_t offset) const
+	{
+		auto it = std::upper_bound(entries.begin(), entries.end(), offset, [](uint32_t o, const SourceMapEntry &entry) { return o < entry.offset; });
+		if (it == entries.begin())
+			return nullptr;
+		return &*(it - 1);
+	}
+
+	std::vector<unsigned char> WriteSourceMap(const SourceMap &source_map)
+	{
+		std::vector<unsigned char> sidecar(s_source_map_magic, s_source_map_magic + 4);
+
+		auto add_varint = [&sidecar](uint64_t value)
+			{
+				do
+				{
+					unsigned char byte = value & 0x7F;
+					value >>= 7;
+					if (value != 0)
+						byte |= 0x80;
+					sidecar.push_back(byte);
+				} while (value != 0);
+			};
+
+		add_varint(source_map.files.size());
+		for (const auto &file : source_map.files)
+		{
+			sidecar.insert(sidecar.end(), file.begin(), file.end());
+			sidecar.push_back(0);
+		}
+
+		add_varint(source_map.entries.size());
+		uint32_t offset = 0;
+		int64_t line = 0;
+		for (const auto &entry : source_map.entries)
+		{
+			int64_t line_delta = (int64_t)entry.line - line;
+			add_varint(entry.offset - offset);
+			add_varint(entry.file);
+			add_varint(line_delta >= 0 ? ((uint64_t)line_delta << 1) : (((uint64_t)-line_delta << 1) - 1));
+			add_varint(entry.column);
+			offset = entry.offset;
+			line = entry.line;
+		}
+		return sidecar;
+	}
+
+	SourceMap ReadSourceMap(const void *start, const void *end)
+	{
+		const unsigned char *p = (const unsigned char *)start;
+		const unsigned char *p_end = (const unsigned char *)end;
+
+		if (p_end - p < 4 || std::memcmp(p, s_source_map_magic, 4) != 0)
+			throw std::runtime_error("[ReadSourceMap] Not a source map");
+		p += 4;
+
+		auto get_varint = [&p, p_end]() -> uint64_t
+			{
+				uint64_t value = 0;
+				for (int shift = 0; shift < 64; shift += 7)
+				{
+					if (p >= p_end)
+						throw std::runtime_error("[ReadSourceMap] Unexpected end of file");
+					unsigned char byte = *p++;
+					value |= (uint64_t)(byte & 0x7F) << shift;
+					if (!(byte & 0x80))
+						return value;
+				}
+				throw std::runtime_error("[ReadSourceMap] Invalid varint");
+			};
+
+		SourceMap source_map;
+		source_map.files.resize(get_varint());
+		for (auto &file : source_map.files)
+		{
+			const unsigned char *name_end = std::find(p, p_end, 0);
+			if (name_end == p_end)
+				throw std::runtime_error("[ReadSourceMap] Unexpected end of file");
+			file.assign((const char *)p, name_end - p);
+			p = name_end + 1;
+		}
+
+		source_map.entries.resize(get_varint());
+		uint32_t offset = 0;
+		int64_t line = 0;
+		for (auto &entry : source_map.entries)
+		{
+			offset += (uint32_t)get_varint();
+			entry.offset = offset;
+			entry.file = (uint32_t)get_varint();
+			uint64_t zigzag = get_varint();
+			line += (zigzag & 1) ? -(int64_t)((zigzag + 1) >> 1) : (int64_t)(zigzag >> 1);
+			entry.line = (uint32_t)line;
+			entry.column = (uint32_t)get_varint();
+		}
+		return source_map;
+	}
+}
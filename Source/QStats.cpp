@@ -0,0 +1,95 @@
+#include <QScript/QStats.h>
+
+#include "QBinary.h"
+
+namespace QScript
+{
+	const char *Stats::TokenName(unsigned char token)
+	{
+		switch ((Token)token)
+		{
+			case Token::EndOfFile: return "EndOfFile";
+			case Token::EndOfLine: return "EndOfLine";
+			case Token::EndOfLineNumber: return "EndOfLineNumber";
+			case Token::StartStruct: return "StartStruct";
+			case Token::EndStruct: return "EndStruct";
+			case Token::StartArray: return "StartArray";
+			case Token::EndArray: return "EndArray";
+			case Token::Equals: return "Equals";
+			case Token::Dot: return "Dot";
+			case Token::Comma: return "Comma";
+			case Token::Minus: return "Minus";
+			case Token::Add: return "Add";
+			case Token::Divide: return "Divide";
+			case Token::Multiply: return "Multiply";
+			case Token::OpenParenth: return "OpenParenth";
+			case Token::CloseParenth: return "CloseParenth";
+			case Token::DebugInfo: return "DebugInfo";
+			case Token::SameAs: return "SameAs";
+			case Token::LessThan: return "LessThan";
+			case Token::LessThanEqual: return "LessThanEqual";
+			case Token::GreaterThan: return "GreaterThan";
+			case Token::GreaterThanEqual: return "GreaterThanEqual";
+			case Token::Name: return "Name";
+			case Token::Integer: return "Integer";
+			case Token::HexInteger: return "HexInteger";
+			case Token::Enum: return "Enum";
+			case Token::Float: return "Float";
+			case Token::String: return "String";
+			case Token::LocalString: return "LocalString";
+			case Token::Array: return "Array";
+			case Token::Vector: return "Vector";
+			case Token::Pair: return "Pair";
+			case Token::KeywordBegin: return "KeywordBegin";
+			case Token::KeywordRepeat: return "KeywordRepeat";
+			case Token::KeywordBreak: return "KeywordBreak";
+			case Token::KeywordScript: return "KeywordScript";
+			case Token::KeywordEndScript: return "KeywordEndScript";
+			case Token::KeywordIf: return "KeywordIf";
+			case Token::KeywordElse: return "KeywordElse";
+			case Token::KeywordElseIf: return "KeywordElseIf";
+			case Token::KeywordEndIf: return "KeywordEndIf";
+			case Token::KeywordReturn: return "KeywordReturn";
+			case Token::Undefined: return "Undefined";
+			case Token::ChecksumName: return "ChecksumName";
+			case Token::KeywordAllArgs: return "KeywordAllArgs";
+			case Token::Arg: return "Arg";
+			case Token::Jump: return "Jump";
+			case Token::KeywordRandom: return "KeywordRandom";
+			case Token::KeywordRandomRange: return "KeywordRandomRange";
+			case Token::At: return "At";
+			case Token::Or: return "Or";
+			case Token::And: return "And";
+			case Token::Xor: return "Xor";
+			case Token::ShiftLeft: return "ShiftLeft";
+			case Token::ShiftRight: return "ShiftRight";
+			case Token::KeywordRandom2: return "KeywordRandom2";
+			case Token::KeywordRandomRange2: return "KeywordRandomRange2";
+			case Token::KeywordNot: return "KeywordNot";
+			case Token::KeywordAnd: return "KeywordAnd";
+			case Token::KeywordOr: return "KeywordOr";
+			case Token::KeywordSwitch: return "KeywordSwitch";
+			case Token::KeywordEndSwitch: return "KeywordEndSwitch";
+			case Token::KeywordCase: return "KeywordCase";
+			case Token::KeywordDefault: return "KeywordDefault";
+			case Token::KeywordRandomNoRepeat: return "KeywordRandomNoRepeat";
+			case Token::KeywordRandomPermute: return "KeywordRandomPermute";
+			case Token::Colon: return "Colon";
+			case Token::FastIf: return "FastIf";
+			case Token::FastElse: return "FastElse";
+			case Token::ShortJump: return "ShortJump";
+			default: return nullptr;
+		}
+	}
+
+	void CountTokens(char *p_start, char *p_end, Stats &stats)
+	{
+		Error error;
+		for (char *p_token = p_start; p_token != nullptr; p_token = SkipToken(p_start, p_end, p_token, error))
+		{
+			stats.tokens[(unsigned char)*p_token]++;
+			if ((Token)*p_token == Token::ChecksumName)
+				stats.checksum_entries++;
+		}
+	}
+}
@@ -0,0 +1,158 @@
+#include <QScript/QSymbolize.h>
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "QBinary.h"
+
+namespace QScript
+{
+	// Symbolizer session
+	struct SymbolizerData
+	{
+		size_t size = 0;
+
+		std::vector<Definition> definitions;
+		std::vector<std::string> names; // By definition
+
+		// Sorted by offset
+		std::vector<size_t> token_starts;
+		std::vector<size_t> token_lines;
+		std::vector<unsigned char> token_types;
+
+		std::vector<std::pair<uint32_t, std::string_view>> checksum_strings;
+	};
+
+	Symbolizer::Symbolizer() : data(new SymbolizerData())
+	{
+
+	}
+
+	Symbolizer::~Symbolizer()
+	{
+
+	}
+
+	static bool Load(SymbolizerData &data, std::span<const std::byte> binary, const Symbols &symbols, Error &error)
+	{
+		char *p_start = (char *)binary.data();
+		char *p_end = p_start + binary.size();
+
+		data.size = 0;
+		data.definitions.clear();
+		data.names.clear();
+		data.token_starts.clear();
+		data.token_lines.clear();
+		data.token_types.clear();
+
+		if (!CheckBinary(p_start, p_end, error))
+			return false;
+
+		// Name definitions, names in the binary take priority over symbols
+		GetChecksumStrings(p_start, p_end, p_start, data.checksum_strings);
+		GetDefinitions(p_start, p_end, data.definitions);
+
+		data.names.resize(data.definitions.size());
+		for (size_t i = 0; i < data.definitions.size(); i++)
+		{
+			const auto &definition = data.definitions[i];
+			if (!definition.named)
+				continue;
+
+			auto it = std::lower_bound(data.checksum_strings.begin(), data.checksum_strings.end(), definition.checksum, [](const std::pair<uint32_t, std::string_view> &a, uint32_t b) { return a.first < b; });
+			if (it != data.checksum_strings.end() && it->first == definition.checksum)
+			{
+				data.names[i] = it->second;
+				continue;
+			}
+
+			auto find = symbols.find(definition.checksum);
+			if (find != symbols.end())
+				data.names[i] = find->second;
+		}
+		data.checksum_strings.clear();
+
+		// Index tokens
+		// The decompiler writes a line for every line end, and ends the line after each ENDSCRIPT
+		size_t line = 1;
+		for (char *p_token = p_start; p_token != nullptr; p_token = SkipToken(p_start, p_end, p_token))
+		{
+			data.token_starts.push_back(p_token - p_start);
+			data.token_lines.push_back(line);
+			data.token_types.push_back((unsigned char)*p_token);
+
+			switch ((Token)*p_token)
+			{
+				case Token::EndOfLine:
+				case Token::EndOfLineNumber:
+				case Token::KeywordEndScript:
+					line++;
+					break;
+				default:
+					break;
+			}
+		}
+
+		data.size = binary.size();
+		return true;
+	}
+
+	static Symbol Symbolize(const SymbolizerData &data, size_t offset)
+	{
+		Symbol symbol;
+		if (offset >= data.size || data.token_starts.empty())
+			return symbol;
+		symbol.valid = true;
+
+		// Last token starting at or before the offset, the first token always starts at 0
+		size_t token = std::upper_bound(data.token_starts.begin(), data.token_starts.end(), offset) - data.token_starts.begin() - 1;
+		symbol.token = data.token_starts[token];
+		symbol.type = data.token_types[token];
+		symbol.line = data.token_lines[token];
+
+		// Last definition starting at or before the offset, if the offset is before its end
+		auto it = std::upper_bound(data.definitions.begin(), data.definitions.end(), offset, [](size_t a, const Definition &b) { return a < b.start; });
+		if (it == data.definitions.begin())
+			return symbol;
+		--it;
+		if (offset >= it->end)
+			return symbol;
+
+		symbol.in_definition = true;
+		symbol.name = data.names[it - data.definitions.begin()];
+		symbol.checksum = it->checksum;
+		symbol.is_script = it->is_script;
+		symbol.start = it->start;
+		symbol.relative = offset - it->start;
+		return symbol;
+	}
+
+	bool Symbolizer::Load(std::span<const std::byte> binary, const Symbols &symbols, Error &error) noexcept
+	{
+		error = Error();
+		try
+		{
+			return QScript::Load(*data, binary, symbols, error);
+		}
+		catch (const std::exception &e)
+		{
+			error.code = ErrorCode::Internal;
+			error.detail = e.what();
+			return false;
+		}
+	}
+
+	Symbol Symbolizer::Symbolize(size_t offset) const noexcept
+	{
+		return QScript::Symbolize(*data, offset);
+	}
+
+	void Symbolizer::Symbolize(std::span<const size_t> offsets, std::span<Symbol> symbols) const noexcept
+	{
+		size_t count = std::min(offsets.size(), symbols.size());
+		for (size_t i = 0; i < count; i++)
+			symbols[i] = QScript::Symbolize(*data, offsets[i]);
+	}
+}
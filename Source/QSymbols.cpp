@@ -0,0 +1,37 @@
+#include <QScript/QSymbols.h>
+
+#include <algorithm>
+
+#include "QBinary.h"
+
+namespace QScript
+{
+	std::vector<unsigned char> WriteSymbols(const Symbols &symbols)
+	{
+		// Sort by checksum so sidecars are reproducible
+		std::vector<std::pair<uint32_t, std::string>> sorted(symbols.begin(), symbols.end());
+		std::sort(sorted.begin(), sorted.end());
+
+		std::vector<unsigned char> sidecar;
+		for (const auto &symbol : sorted)
+		{
+			sidecar.push_back((unsigned char)Token::ChecksumName);
+			sidecar.push_back((unsigned char)((symbol.first >> 0) & 0xFF));
+			sidecar.push_back((unsigned char)((symbol.first >> 8) & 0xFF));
+			sidecar.push_back((unsigned char)((symbol.first >> 16) & 0xFF));
+			sidecar.push_back((unsigned char)((symbol.first >> 24) & 0xFF));
+			for (const auto &c : symbol.second)
+				sidecar.push_back((unsigned char)c);
+			sidecar.push_back(0);
+		}
+		sidecar.push_back((unsigned char)Token::EndOfFile);
+		return sidecar;
+	}
+
+	Symbols ReadSymbols(void *start, void *end)
+	{
+		char *p_start = (char *)start;
+		char *p_end = (char *)end;
+		return GetChecksumStrings(p_start, p_end, p_start);
+	}
+}
@@ -0,0 +1,160 @@
+#include <QScript/QTrace.h>
+
+#ifdef QSCRIPT_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace QScript
+{
+	namespace Trace
+	{
+		using Clock = std::chrono::steady_clock;
+
+		struct Event
+		{
+			const char *name;
+			std::string detail;
+			int64_t start, duration; // Nanoseconds from the start of the trace
+		};
+
+		// Events of one thread
+		// The lock is only contended while the trace is being stopped
+		struct ThreadEvents
+		{
+			uint32_t id = 0;
+			std::mutex mutex;
+			std::vector<Event> events;
+		};
+
+		static std::atomic<bool> recording(false);
+		static Clock::time_point epoch;
+
+		static std::mutex threads_mutex;
+		static std::vector<std::shared_ptr<ThreadEvents>> threads;
+		static uint32_t next_thread_id = 1;
+
+		static thread_local std::shared_ptr<ThreadEvents> local_events;
+
+		static ThreadEvents &LocalEvents()
+		{
+			if (local_events == nullptr)
+			{
+				local_events = std::make_shared<ThreadEvents>();
+
+				std::lock_guard<std::mutex> lock(threads_mutex);
+				local_events->id = next_thread_id++;
+				threads.push_back(local_events);
+			}
+			return *local_events;
+		}
+
+		static int64_t Now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+		}
+
+		static void WriteString(std::ostream &out, std::string_view string)
+		{
+			static const char hex[] = "0123456789abcdef";
+			out << '"';
+			for (char c : string)
+			{
+				switch (c)
+				{
+					case '"': out << "\\\""; break;
+					case '\\': out << "\\\\"; break;
+					case '\n': out << "\\n"; break;
+					case '\t': out << "\\t"; break;
+					default:
+						if ((unsigned char)c < 0x20)
+							out << "\\u00" << hex[(c >> 4) & 0xF] << hex[c & 0xF];
+						else
+							out << c;
+						break;
+				}
+			}
+			out << '"';
+		}
+
+		void Start()
+		{
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			for (auto &thread : threads)
+			{
+				std::lock_guard<std::mutex> thread_lock(thread->mutex);
+				thread->events.clear();
+			}
+			epoch = Clock::now();
+			recording = true;
+		}
+
+		bool Stop(std::ostream &out)
+		{
+			recording = false;
+
+			std::lock_guard<std::mutex> lock(threads_mutex);
+			out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			bool first = true;
+			for (auto &thread : threads)
+			{
+				std::lock_guard<std::mutex> thread_lock(thread->mutex);
+				for (const auto &event : thread->events)
+				{
+					if (!first)
+						out << ",\n";
+					first = false;
+
+					// Complete events, timestamps are in microseconds
+					out << "{\"name\":\"" << event.name << "\",\"cat\":\"qscript\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id;
+					out << ",\"ts\":" << event.start / 1000 << '.' << event.start % 1000 / 100;
+					out << ",\"dur\":" << event.duration / 1000 << '.' << event.duration % 1000 / 100;
+					if (!event.detail.empty())
+					{
+						out << ",\"args\":{\"detail\":";
+						WriteString(out, event.detail);
+						out << '}';
+					}
+					out << '}';
+				}
+				thread->events.clear();
+			}
+			out << "\n]}\n";
+
+			// Forget threads that have exited
+			std::erase_if(threads, [](const std::shared_ptr<ThreadEvents> &thread) { return thread.use_count() == 1; });
+			return (bool)out;
+		}
+
+		Scope::Scope(const char *_name) : name(_name), start(-1)
+		{
+			if (recording.load(std::memory_order_relaxed))
+				start = Now();
+		}
+
+		Scope::Scope(const char *_name, std::string_view _detail) : name(_name), start(-1)
+		{
+			if (recording.load(std::memory_order_relaxed))
+			{
+				detail = _detail;
+				start = Now();
+			}
+		}
+
+		Scope::~Scope()
+		{
+			if (start < 0 || !recording.load(std::memory_order_relaxed))
+				return;
+
+			int64_t end = Now();
+			ThreadEvents &events = LocalEvents();
+			std::lock_guard<std::mutex> lock(events.mutex);
+			events.events.push_back({ name, std::move(detail), start, end - start });
+		}
+	}
+}
+
+#endif
@@ -1,13 +1,14 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 
 namespace QScript
 {
 	// String escape function
-	static inline std::string EscapeString(const std::string &string)
+	// Appends to the output, so a kept buffer can be reused
+	static inline void EscapeString(std::string_view string, std::string &esc)
 	{
-		std::string esc;
 		for (auto &i : string)
 		{
 			if (i == '\n')
@@ -40,6 +41,12 @@ namespace QScript
 				esc += escaper;
 			}
 		}
+	}
+
+	static inline std::string EscapeString(std::string_view string)
+	{
+		std::string esc;
+		EscapeString(string, esc);
 		return esc;
 	}
 	
@@ -128,6 +135,27 @@ namespace QScript
 		return out;
 	}
 
+	// Compares two strings as their simple strings, without making them
+	static inline bool SimpleStringEqual(std::string_view a, std::string_view b)
+	{
+		if (a.size() != b.size())
+			return false;
+		auto simple = [](char c) -> char
+			{
+				if (c >= 'A' && c <= 'Z')
+					return 'a' + c - 'A';
+				if (c == '/')
+					return '\\';
+				return c;
+			};
+		for (size_t i = 0; i < a.size(); i++)
+		{
+			if (simple(a[i]) != simple(b[i]))
+				return false;
+		}
+		return true;
+	}
+
 	static inline unsigned long CRC(const char *literal)
 	{
 		unsigned long rc = 0xffffffff;
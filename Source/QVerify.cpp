@@ -0,0 +1,250 @@
+#include <QScript/QVerify.h>
+
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "QBinary.h"
+
+namespace QScript
+{
+	// Verifier session
+	struct VerifyJump
+	{
+		size_t token = 0; // Offset of the jumping token
+		ptrdiff_t target = 0;
+	};
+
+	struct VerifyBlock
+	{
+		size_t token = 0; // Offset of the opening token
+		bool is_switch = false;
+		bool has_else = false;
+	};
+
+	struct VerifierData
+	{
+		std::vector<uint64_t> boundaries; // A bit for every byte, set where a token starts
+		std::vector<VerifyJump> jumps;
+		std::vector<size_t> randoms;
+		std::vector<VerifyBlock> blocks;
+	};
+
+	Verifier::Verifier() : data(new VerifierData())
+	{
+
+	}
+
+	Verifier::~Verifier()
+	{
+
+	}
+
+	// Reads without checks, tokens have already been checked to be in the binary
+	static uint32_t ReadInt(const char *p)
+	{
+		return (uint32_t)(unsigned char)p[0] | ((uint32_t)(unsigned char)p[1] << 8) | ((uint32_t)(unsigned char)p[2] << 16) | ((uint32_t)(unsigned char)p[3] << 24);
+	}
+
+	static uint16_t ReadShort(const char *p)
+	{
+		return (uint16_t)((unsigned char)p[0] | ((unsigned char)p[1] << 8));
+	}
+
+	static bool Verify(VerifierData &data, std::span<const std::byte> binary, Error &error)
+	{
+		char *p_start = (char *)binary.data();
+		char *p_end = p_start + binary.size();
+		size_t size = binary.size();
+
+		auto fail = [&](ErrorCode code, size_t offset, std::string detail = std::string()) -> bool
+			{
+				error.code = code;
+				error.offset = offset;
+				error.value = (offset < size) ? (unsigned char)p_start[offset] : 0;
+				error.detail = std::move(detail);
+				return false;
+			};
+
+		auto is_boundary = [&data, size](ptrdiff_t address) -> bool
+			{
+				if (address < 0 || (size_t)address >= size)
+					return false;
+				return (data.boundaries[(size_t)address >> 6] >> ((size_t)address & 63)) & 1;
+			};
+
+		data.boundaries.assign((size + 63) >> 6, 0);
+		data.jumps.clear();
+		data.randoms.clear();
+		data.blocks.clear();
+
+		// Walk the tokens once, marking where they start and collecting the jumps to check afterwards
+		char *p_token = p_start;
+		while (1)
+		{
+			char *p_next = SkipToken(p_start, p_end, p_token, error);
+			if (error)
+				return false;
+
+			size_t offset = p_token - p_start;
+			data.boundaries[offset >> 6] |= (uint64_t)1 << (offset & 63);
+
+			if (p_next == nullptr)
+			{
+				// End of file has to be the last byte
+				if (offset + 1 != size)
+					return fail(ErrorCode::DataAfterEndOfFile, offset + 1);
+				break;
+			}
+
+			switch ((Token)*p_token)
+			{
+				case Token::FastIf:
+				case Token::FastElse:
+				case Token::ShortJump:
+					data.jumps.push_back(VerifyJump{ offset, (ptrdiff_t)offset + 1 + (int16_t)ReadShort(p_token + 1) });
+					break;
+				case Token::Jump:
+					data.jumps.push_back(VerifyJump{ offset, (ptrdiff_t)offset + 5 + (int32_t)ReadInt(p_token + 1) });
+					break;
+				case Token::KeywordRandom:
+				case Token::KeywordRandom2:
+				case Token::KeywordRandomNoRepeat:
+				case Token::KeywordRandomPermute:
+					data.randoms.push_back(offset);
+					break;
+				default:
+					break;
+			}
+
+			// Check nesting
+			switch ((Token)*p_token)
+			{
+				case Token::FastIf:
+				case Token::KeywordIf:
+					data.blocks.push_back(VerifyBlock{ offset, false, false });
+					break;
+				case Token::FastElse:
+				case Token::KeywordElse:
+					if (data.blocks.empty() || data.blocks.back().is_switch || data.blocks.back().has_else)
+						return fail(ErrorCode::UnmatchedElse, offset);
+					data.blocks.back().has_else = true;
+					break;
+				case Token::KeywordEndIf:
+					if (data.blocks.empty() || data.blocks.back().is_switch)
+						return fail(ErrorCode::UnmatchedEndIf, offset);
+					data.blocks.pop_back();
+					break;
+				case Token::KeywordSwitch:
+					data.blocks.push_back(VerifyBlock{ offset, true, false });
+					break;
+				case Token::KeywordCase:
+				case Token::KeywordDefault:
+					if (data.blocks.empty() || !data.blocks.back().is_switch)
+						return fail(ErrorCode::UnmatchedCase, offset);
+					break;
+				case Token::KeywordEndSwitch:
+					if (data.blocks.empty() || !data.blocks.back().is_switch)
+						return fail(ErrorCode::UnmatchedEndSwitch, offset);
+					data.blocks.pop_back();
+					break;
+				default:
+					break;
+			}
+
+			p_token = p_next;
+		}
+
+		if (!data.blocks.empty())
+		{
+			const auto &block = data.blocks.back();
+			return fail(block.is_switch ? ErrorCode::UnclosedSwitch : ErrorCode::UnclosedIf, block.token);
+		}
+
+		// Every jump has to land on a token
+		for (const auto &jump : data.jumps)
+		{
+			if (jump.target < 0 || (size_t)jump.target >= size)
+				return fail(ErrorCode::JumpOutOfRange, jump.token, "to " + std::to_string(jump.target));
+			if (!is_boundary(jump.target))
+				return fail(ErrorCode::JumpIntoToken, jump.token, "to " + std::to_string(jump.target));
+		}
+
+		// Every case of a RANDOM has to come in order after its table, and all but the last end with a jump to the same place
+		for (const auto &random : data.randoms)
+		{
+			uint32_t num_jumps = ReadInt(p_start + random + 1);
+			size_t table_end = random + 5 + 6 * (size_t)num_jumps;
+
+			ptrdiff_t last_case = (ptrdiff_t)table_end - 1;
+			ptrdiff_t end = -1;
+			for (uint32_t i = 0; i < num_jumps; i++)
+			{
+				size_t field = random + 5 + 2 * (size_t)num_jumps + 4 * (size_t)i;
+				ptrdiff_t address = (ptrdiff_t)field + 4 + (int32_t)ReadInt(p_start + field);
+				if (address < 0 || (size_t)address >= size)
+					return fail(ErrorCode::JumpOutOfRange, random, "case " + std::to_string(i) + " to " + std::to_string(address));
+				if (!is_boundary(address))
+					return fail(ErrorCode::JumpIntoToken, random, "case " + std::to_string(i) + " to " + std::to_string(address));
+				if (address <= last_case)
+					return fail(ErrorCode::BadRandom, random, "case " + std::to_string(i) + " is out of order");
+
+				if (i > 0)
+				{
+					ptrdiff_t jump = address - 5;
+					if (jump < last_case || !is_boundary(jump) || (Token)p_start[jump] != Token::Jump)
+						return fail(ErrorCode::BadRandom, random, "case " + std::to_string(i - 1) + " doesn't end with a jump");
+
+					ptrdiff_t jump_address = jump + 5 + (int32_t)ReadInt(p_start + jump + 1);
+					if (end == -1)
+						end = jump_address;
+					else if (jump_address != end)
+						return fail(ErrorCode::BadRandom, random, "case " + std::to_string(i - 1) + " jumps to a different end");
+				}
+				last_case = address;
+			}
+			if (end != -1 && end < last_case)
+				return fail(ErrorCode::BadRandom, random, "end is before the last case");
+		}
+
+		return true;
+	}
+
+	static bool VerifyNoThrow(VerifierData &data, std::span<const std::byte> binary, Error &error) noexcept
+	{
+		error = Error();
+		try
+		{
+			return Verify(data, binary, error);
+		}
+		catch (const std::exception &e)
+		{
+			error.code = ErrorCode::Internal;
+			error.detail = e.what();
+			return false;
+		}
+	}
+
+	bool Verifier::Verify(std::span<const std::byte> binary, Error &error) noexcept
+	{
+		return VerifyNoThrow(*data, binary, error);
+	}
+
+	// Verify function
+	bool Verify(std::span<const std::byte> binary, Error &error) noexcept
+	{
+		try
+		{
+			VerifierData data;
+			return VerifyNoThrow(data, binary, error);
+		}
+		catch (const std::exception &e)
+		{
+			error = Error();
+			error.code = ErrorCode::Internal;
+			error.detail = e.what();
+			return false;
+		}
+	}
+}
@@ -0,0 +1,156 @@
+#include <QScript/QCompile.h>
+#include <QScript/QDecompile.h>
+
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "QAlloc.h"
+#include "Test.h"
+
+#ifndef QSCRIPT_ALLOC_STATS
+#error The allocation test counts allocations, it must be built with QSCRIPT_ALLOC_STATS
+#endif
+
+// Allocation bounds for a whole compile or decompile, per byte of input
+// These hold with room to spare, a change that breaks one is allocating per token or per line
+struct Bounds
+{
+	double count;
+	double bytes;
+};
+
+static constexpr Bounds COMPILE_BOUNDS = { 0.05, 64.0 };
+static constexpr Bounds DECOMPILE_BOUNDS = { 0.005, 16.0 };
+
+// Allocations a warm session may make for a compile or decompile
+static constexpr size_t WARM_ALLOCATIONS = 8;
+
+// A script with the common kinds of lines, repeated with different names
+static std::string MakeSource(int scripts)
+{
+	std::string source;
+	for (int i = 0; i < scripts; i++)
+	{
+		std::string n = std::to_string(i);
+		source += "global_" + n + " = { value = " + n + " name = \"global " + n + "\" position = (1.0, 2.0, 3.0) }\n";
+		source += "SCRIPT script_" + n + " value = 0\n";
+		source += "\tIF (<value> > " + n + ")\n";
+		source += "\t\tcall_" + n + " value = <value> scale = 0.5 flag\n";
+		source += "\tELSE\n";
+		source += "\t\tother_" + n + " text = #\"local " + n + "\" list = [ 1 2 3 ]\n";
+		source += "\tENDIF\n";
+		source += "\tSWITCH <value>\n";
+		source += "\t\tCASE 1\n";
+		source += "\t\t\tcase_" + n + "\n";
+		source += "\t\tDEFAULT\n";
+		source += "\t\t\tRETURN result = global_" + n + "\n";
+		source += "\tENDSWITCH\n";
+		source += "ENDSCRIPT\n";
+	}
+	return source;
+}
+
+// Counts the allocations made by a function
+template <typename F>
+static QScript::AllocCounters Count(F &&function)
+{
+	QScript::AllocCounters start = QScript::GetAllocCounters();
+	function();
+	QScript::AllocCounters end = QScript::GetAllocCounters();
+
+	QScript::AllocCounters counted;
+	counted.count = end.count - start.count;
+	counted.bytes = end.bytes - start.bytes;
+	return counted;
+}
+
+static void CheckBounds(const char *name, const QScript::AllocCounters &counted, size_t input_bytes, const Bounds &bounds)
+{
+	double count = (double)counted.count / (double)input_bytes;
+	double bytes = (double)counted.bytes / (double)input_bytes;
+	std::cout << name << ": " << counted.count << " allocations, " << counted.bytes << " bytes for " << input_bytes << " input bytes (" <<
+		count << " allocations, " << bytes << " bytes per byte)" << std::endl;
+	TEST_CHECK(count <= bounds.count);
+	TEST_CHECK(bytes <= bounds.bytes);
+}
+
+int main()
+{
+	std::string source = MakeSource(256);
+
+	for (QScript::Target target : { QScript::Target::THUG1, QScript::Target::THUG2 })
+	{
+		const char *target_name = (target == QScript::Target::THUG1) ? "THUG1" : "THUG2";
+
+		// Compile
+		std::vector<unsigned char> bytecode;
+		QScript::AllocCounters compile = Count([&]() { bytecode = QScript::Compile(source, target); });
+		std::cout << target_name << " ";
+		CheckBounds("compile", compile, source.size(), COMPILE_BOUNDS);
+
+		// Decompile
+		std::span<const std::byte> binary((const std::byte *)bytecode.data(), bytecode.size());
+		std::string text;
+		QScript::AllocCounters decompile = Count([&]() { text = QScript::Decompile(binary); });
+		std::cout << target_name << " ";
+		CheckBounds("decompile", decompile, bytecode.size(), DECOMPILE_BOUNDS);
+		TEST_CHECK(!text.empty());
+
+		// The stats count the same allocations, split into phases
+		QScript::Stats stats;
+		QScript::CompileOptions options;
+		options.stats = &stats;
+		QScript::AllocCounters counted = Count([&]() { bytecode = QScript::Compile(source, target, options); });
+		size_t phases = stats.lex_allocations.count + stats.emit_allocations.count + stats.finish_allocations.count;
+		TEST_CHECK(QScript::Stats::allocations_counted);
+		TEST_CHECK(phases != 0);
+		TEST_CHECK(phases <= counted.count);
+	}
+
+	// A warm session only allocates a few times per compile or decompile, however big the input
+	{
+		QScript::Compiler compiler;
+		QScript::CompileResult result;
+		QScript::Decompiler decompiler;
+		for (QScript::Target target : { QScript::Target::THUG1, QScript::Target::THUG2 })
+		{
+			// The result trades buffers with the session, so both sides need a compile to warm up
+			compiler.Compile(source, target, QScript::CompileOptions(), result);
+			compiler.Compile(source, target, QScript::CompileOptions(), result);
+			QScript::AllocCounters compile = Count([&]() { compiler.Compile(source, target, QScript::CompileOptions(), result); });
+			std::cout << "warm compile: " << compile.count << " allocations, " << compile.bytes << " bytes" << std::endl;
+			TEST_CHECK(compile.count <= WARM_ALLOCATIONS);
+
+			std::span<const std::byte> binary((const std::byte *)result.bytecode.data(), result.bytecode.size());
+			decompiler.Decompile(binary);
+			QScript::AllocCounters decompile = Count([&]() { decompiler.Decompile(binary); });
+			std::cout << "warm decompile: " << decompile.count << " allocations, " << decompile.bytes << " bytes" << std::endl;
+			TEST_CHECK(decompile.count <= WARM_ALLOCATIONS);
+
+			// A caller's buffer gets the same bytecode, and a buffer that's too small is left alone
+			std::vector<std::byte> output(result.bytecode.size(), std::byte(0xAA));
+			size_t size = compiler.Compile(source, target, QScript::CompileOptions(), std::span<std::byte>(output.data(), output.size() - 1));
+			TEST_CHECK(size == result.bytecode.size());
+			TEST_CHECK(output.back() == std::byte(0xAA) && output.front() == std::byte(0xAA));
+
+			QScript::AllocCounters buffer = Count([&]() { size = compiler.Compile(source, target, QScript::CompileOptions(), std::span<std::byte>(output)); });
+			std::cout << "warm compile into a buffer: " << buffer.count << " allocations, " << buffer.bytes << " bytes" << std::endl;
+			TEST_CHECK(buffer.count <= WARM_ALLOCATIONS);
+			TEST_CHECK(size == result.bytecode.size());
+			TEST_CHECK(std::memcmp(output.data(), result.bytecode.data(), size) == 0);
+
+			// The free function keeps a session too
+			QScript::Compile(source, target, QScript::CompileOptions(), std::span<std::byte>(output));
+			QScript::AllocCounters free_buffer = Count([&]() { size = QScript::Compile(source, target, QScript::CompileOptions(), std::span<std::byte>(output)); });
+			TEST_CHECK(free_buffer.count <= WARM_ALLOCATIONS);
+			TEST_CHECK(size == result.bytecode.size());
+			TEST_CHECK(std::memcmp(output.data(), result.bytecode.data(), size) == 0);
+		}
+	}
+
+	return Test::Result();
+}
@@ -0,0 +1,181 @@
+#include <QScript/QCompile.h>
+#include <QScript/QDecompile.h>
+#include <QScript/QSymbols.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "Daemon.h"
+#include "Test.h"
+
+static const char *SOURCE =
+	"shared_global = { value = 1 name = \"shared\" }\n"
+	"SCRIPT daemon_script value = 0\n"
+	"\tIF (<value> > 1)\n"
+	"\t\tshared_call value = <value>\n"
+	"\tELSE\n"
+	"\t\tlocal_call\n"
+	"\tENDIF\n"
+	"ENDSCRIPT\n";
+
+// Connects to the daemon, retrying while it starts up
+static int Connect(const std::string &path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+	for (int attempt = 0; attempt < 100; attempt++)
+	{
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		if (connect(fd, (const sockaddr*)&address, sizeof(address)) == 0)
+			return fd;
+		close(fd);
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+	return -1;
+}
+
+// Sends a request and waits for its response
+static bool Request(int fd, const std::vector<unsigned char> &request, std::vector<unsigned char> &response)
+{
+	return Daemon::SendMessage(fd, request) && Daemon::ReceiveMessage(fd, response) && !response.empty();
+}
+
+static std::vector<unsigned char> CompileRequest(QScript::Target target, uint8_t flags, const std::string &name, const std::string &source)
+{
+	std::vector<unsigned char> request;
+	request.push_back((unsigned char)Daemon::Command::Compile);
+	request.push_back((unsigned char)target);
+	request.push_back(flags);
+	Daemon::PutInt(request, (uint32_t)name.size());
+	request.insert(request.end(), name.begin(), name.end());
+	request.insert(request.end(), source.begin(), source.end());
+	return request;
+}
+
+static std::vector<unsigned char> DecompileRequest(const std::vector<unsigned char> &bytecode)
+{
+	std::vector<unsigned char> request;
+	request.push_back((unsigned char)Daemon::Command::Decompile);
+	request.insert(request.end(), bytecode.begin(), bytecode.end());
+	return request;
+}
+
+// Checks that a response succeeded with the expected body
+static bool Responded(const std::vector<unsigned char> &response, const void *body, size_t size)
+{
+	return response.size() == size + 1 && (Daemon::Status)response[0] == Daemon::Status::Ok && std::equal(response.begin() + 1, response.end(), (const unsigned char*)body);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <daemon>" << std::endl;
+		return 1;
+	}
+
+	// Write a dictionary for the daemon to keep loaded
+	std::filesystem::path temp = std::filesystem::temp_directory_path();
+	std::string stem = "qscript-daemon-test-" + std::to_string(getpid());
+	std::string socket_path = (temp / (stem + ".sock")).string();
+	std::string dictionary_path = (temp / (stem + ".qbsym")).string();
+
+	QScript::Symbols dictionary;
+	{
+		QScript::CompileOptions options;
+		options.strip_checksum_names = true;
+		QScript::CompileResult shared;
+		QScript::Compile("shared_global = shared_call\n", QScript::Target::THUG2, options, shared);
+		dictionary = shared.symbols;
+
+		std::vector<unsigned char> data = QScript::WriteSymbols(dictionary);
+		std::ofstream file(dictionary_path, std::ios::binary);
+		file.write((const char*)data.data(), data.size());
+	}
+
+	// Start the daemon
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		execl(argv[1], argv[1], "-socket", socket_path.c_str(), "-dictionary", dictionary_path.c_str(), (char*)nullptr);
+		_exit(127);
+	}
+	TEST_CHECK(pid > 0);
+
+	int fd = (pid > 0) ? Connect(socket_path) : -1;
+	if (TEST_CHECK(fd >= 0))
+	{
+		// Compiles match the library, with and without a named cache, and again once the session is warm
+		for (QScript::Target target : { QScript::Target::THUG1, QScript::Target::THUG2 })
+		{
+			QScript::CompileOptions options;
+			options.optimize_branches = true;
+			options.shared_symbols = &dictionary;
+			std::vector<unsigned char> expected = QScript::Compile(SOURCE, target, options);
+
+			std::vector<unsigned char> response;
+			for (const char *name : { "daemon.q", "", "daemon.q" })
+			{
+				TEST_CHECK(Request(fd, CompileRequest(target, Daemon::FLAG_OPTIMIZE, name, SOURCE), response));
+				TEST_CHECK(Responded(response, expected.data(), expected.size()));
+			}
+
+			// Decompiles match the library, names come from the dictionary
+			std::string text = QScript::Decompile(std::span<const std::byte>((const std::byte*)expected.data(), expected.size()), dictionary);
+			TEST_CHECK(Request(fd, DecompileRequest(expected), response));
+			TEST_CHECK(Responded(response, text.data(), text.size()));
+		}
+
+		// Bad requests get an error, and the connection keeps going
+		std::vector<unsigned char> response;
+		TEST_CHECK(Request(fd, CompileRequest((QScript::Target)7, 0, "", SOURCE), response));
+		TEST_CHECK((Daemon::Status)response[0] == Daemon::Status::Error);
+		TEST_CHECK(Request(fd, CompileRequest(QScript::Target::THUG2, 0, "", "SCRIPT broken\nENDIF\nENDSCRIPT\n"), response));
+		TEST_CHECK((Daemon::Status)response[0] == Daemon::Status::Error);
+		TEST_CHECK(Request(fd, DecompileRequest({ 0xFF }), response));
+		TEST_CHECK((Daemon::Status)response[0] == Daemon::Status::Error);
+
+		close(fd);
+	}
+
+	// A later client gets the same answers from the warm workers
+	fd = (pid > 0) ? Connect(socket_path) : -1;
+	if (TEST_CHECK(fd >= 0))
+	{
+		QScript::CompileOptions options;
+		options.shared_symbols = &dictionary;
+		std::vector<unsigned char> expected = QScript::Compile(SOURCE, QScript::Target::THUG2, options);
+
+		std::vector<unsigned char> response;
+		TEST_CHECK(Request(fd, CompileRequest(QScript::Target::THUG2, 0, "", SOURCE), response));
+		TEST_CHECK(Responded(response, expected.data(), expected.size()));
+		close(fd);
+	}
+
+	// Stop the daemon
+	if (pid > 0)
+	{
+		kill(pid, SIGTERM);
+		waitpid(pid, nullptr, 0);
+	}
+	std::filesystem::remove(socket_path);
+	std::filesystem::remove(dictionary_path);
+
+	return Test::Result();
+}
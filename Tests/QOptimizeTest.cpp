@@ -0,0 +1,229 @@
+#include <QScript/QCompile.h>
+#include <QScript/QDecompile.h>
+#include <QScript/QVerify.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "QRewrite.h"
+#include "QToken.h"
+#include "Test.h"
+
+// Compiles with the branch optimization pass and decompiles the result back to text
+static std::string Optimize(const char *source)
+{
+	QScript::CompileOptions options;
+	options.optimize_branches = true;
+	std::vector<unsigned char> bytecode = QScript::Compile(source, QScript::Target::THUG2, options);
+	return QScript::Decompile(std::span<const std::byte>((const std::byte *)bytecode.data(), bytecode.size()));
+}
+
+// Compiles with the branch optimization pass
+static std::vector<unsigned char> OptimizeBytecode(const std::string &source)
+{
+	QScript::CompileOptions options;
+	options.optimize_branches = true;
+	return QScript::Compile(source, QScript::Target::THUG2, options);
+}
+
+static std::string Decompile(const std::vector<unsigned char> &bytecode)
+{
+	return QScript::Decompile(std::span<const std::byte>((const std::byte *)bytecode.data(), bytecode.size()));
+}
+
+// Checks that optimized bytecode verifies, and that its decompiled text optimizes back to the same bytecode
+static bool RoundTrips(const std::vector<unsigned char> &bytecode)
+{
+	QScript::Error error;
+	if (!QScript::Verify(std::span<const std::byte>((const std::byte *)bytecode.data(), bytecode.size()), error))
+	{
+		std::cerr << "Failed to verify: " << error.Message() << std::endl;
+		return false;
+	}
+	return OptimizeBytecode(Decompile(bytecode)) == bytecode;
+}
+
+// Gets where the jumps of a type of token land, in order
+static std::vector<size_t> JumpTargets(std::vector<unsigned char> bytecode, QScript::Token token)
+{
+	std::vector<size_t> tokens = QScript::GetTokenAddresses(bytecode, 0, bytecode.size());
+	std::vector<size_t> targets;
+	for (const auto &relocation : QScript::GetRelocations(bytecode, tokens))
+	{
+		if ((QScript::Token)bytecode[relocation.field - 1] == token)
+			targets.push_back(relocation.target);
+	}
+	return targets;
+}
+
+static bool Contains(const std::string &text, const char *name)
+{
+	return text.find(name) != std::string::npos;
+}
+
+int main()
+{
+	// IF on a literal true keeps only the IF body
+	{
+		std::string text = Optimize(
+			"SCRIPT literal_true\n"
+			"\tIF 1\n"
+			"\t\tkept_call\n"
+			"\tELSE\n"
+			"\t\tdead_call\n"
+			"\tENDIF\n"
+			"ENDSCRIPT\n"
+		);
+		TEST_CHECK(Contains(text, "kept_call"));
+		TEST_CHECK(!Contains(text, "dead_call"));
+		TEST_CHECK(!Contains(text, "IF"));
+	}
+
+	// IF on a literal false keeps only the ELSE body
+	{
+		std::string text = Optimize(
+			"SCRIPT literal_false\n"
+			"\tIF (0)\n"
+			"\t\tdead_call\n"
+			"\tELSE\n"
+			"\t\tkept_call\n"
+			"\tENDIF\n"
+			"ENDSCRIPT\n"
+		);
+		TEST_CHECK(Contains(text, "kept_call"));
+		TEST_CHECK(!Contains(text, "dead_call"));
+		TEST_CHECK(!Contains(text, "ELSE"));
+	}
+
+	// Empty ELSE blocks are removed, the IF stays
+	{
+		std::string text = Optimize(
+			"SCRIPT empty_else\n"
+			"\tIF condition_call\n"
+			"\t\tkept_call\n"
+			"\tELSE\n"
+			"\tENDIF\n"
+			"ENDSCRIPT\n"
+		);
+		TEST_CHECK(Contains(text, "condition_call"));
+		TEST_CHECK(Contains(text, "kept_call"));
+		TEST_CHECK(Contains(text, "ENDIF"));
+		TEST_CHECK(!Contains(text, "ELSE"));
+	}
+
+	// Code after RETURN is removed up to the end of the block
+	{
+		std::string text = Optimize(
+			"SCRIPT return_dead\n"
+			"\tIF condition_call\n"
+			"\t\tRETURN\n"
+			"\t\tdead_call\n"
+			"\tENDIF\n"
+			"\tkept_call\n"
+			"ENDSCRIPT\n"
+		);
+		TEST_CHECK(Contains(text, "kept_call"));
+		TEST_CHECK(!Contains(text, "dead_call"));
+	}
+
+	// A RETURN argument that spans several lines is kept whole, only the code after it is removed
+	{
+		std::string text = Optimize(
+			"SCRIPT return_struct\n"
+			"\tRETURN {\n"
+			"\t\tstruct_member = 1\n"
+			"\t\tarray_member = [\n"
+			"\t\t\tarray_element\n"
+			"\t\t]\n"
+			"\t}\n"
+			"\tdead_call\n"
+			"ENDSCRIPT\n"
+		);
+		TEST_CHECK(Contains(text, "struct_member"));
+		TEST_CHECK(Contains(text, "array_member"));
+		TEST_CHECK(Contains(text, "array_element"));
+		TEST_CHECK(!Contains(text, "dead_call"));
+
+		// The struct still closes where it did, so optimizing again changes nothing
+		TEST_CHECK(Optimize(text.c_str()) == text);
+	}
+
+	// An ELSE that jumps onto another ELSE goes straight to the end of the outer IF
+	{
+		std::vector<unsigned char> bytecode = OptimizeBytecode(
+			"SCRIPT jump_chain\n"
+			"\tIF outer_call\n"
+			"\t\tIF inner_call\n"
+			"\t\t\tinner_if_call\n"
+			"\t\tELSE\n"
+			"\t\t\tinner_else_call\n"
+			"\t\tENDIF\n"
+			"\tELSE\n"
+			"\t\touter_else_call\n"
+			"\tENDIF\n"
+			"\tafter_call\n"
+			"ENDSCRIPT\n"
+		);
+		std::vector<size_t> else_targets = JumpTargets(bytecode, QScript::Token::FastElse);
+		TEST_CHECK(else_targets.size() == 2 && else_targets[0] == else_targets[1]);
+		TEST_CHECK(RoundTrips(bytecode));
+	}
+
+	// The jumps that end SWITCH cases are threaded too, the jumps between cases aren't
+	{
+		std::vector<unsigned char> bytecode = OptimizeBytecode(
+			"SCRIPT switch_chain\n"
+			"\tIF outer_call\n"
+			"\t\tSWITCH <value>\n"
+			"\t\t\tCASE 1\n"
+			"\t\t\t\tfirst_call\n"
+			"\t\t\tCASE 2\n"
+			"\t\t\t\tsecond_call\n"
+			"\t\t\tDEFAULT\n"
+			"\t\t\t\tdefault_call\n"
+			"\t\tENDSWITCH\n"
+			"\tELSE\n"
+			"\t\touter_else_call\n"
+			"\tENDIF\n"
+			"\tafter_call\n"
+			"ENDSCRIPT\n"
+		);
+		std::vector<size_t> else_targets = JumpTargets(bytecode, QScript::Token::FastElse);
+		std::vector<size_t> jump_targets = JumpTargets(bytecode, QScript::Token::ShortJump);
+		TEST_CHECK(else_targets.size() == 1);
+		TEST_CHECK(std::count(jump_targets.begin(), jump_targets.end(), else_targets[0]) == 2);
+		TEST_CHECK(RoundTrips(bytecode));
+
+		std::string text = Decompile(bytecode);
+		TEST_CHECK(Contains(text, "first_call") && Contains(text, "second_call") && Contains(text, "default_call"));
+	}
+
+	// RANDOM jumps stay where they are, they mark the end of the RANDOM
+	{
+		std::vector<unsigned char> bytecode = OptimizeBytecode(
+			"SCRIPT random_in_if\n"
+			"\tIF condition_call\n"
+			"\t\tRANDOM(1, 1)\n"
+			"\t\t\tRANDOMCASE first_call\n"
+			"\t\t\tRANDOMCASE second_call\n"
+			"\t\tRANDOMEND\n"
+			"\tELSE\n"
+			"\t\telse_call\n"
+			"\tENDIF\n"
+			"\tafter_call\n"
+			"ENDSCRIPT\n"
+		);
+		TEST_CHECK(RoundTrips(bytecode));
+
+		std::string text = Decompile(bytecode);
+		size_t random_end = text.find("RANDOMEND");
+		size_t else_keyword = text.find("ELSE");
+		TEST_CHECK(random_end != std::string::npos && else_keyword != std::string::npos && random_end < else_keyword);
+	}
+
+	return Test::Result();
+}
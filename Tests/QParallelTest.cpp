@@ -0,0 +1,129 @@
+#include <QScript/QCompile.h>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Test.h"
+
+// Script bodies that aren't indented, where lines inside them look like top level definitions
+// A split inside a body would leave a RANDOM or IF open in a block
+static std::string UnindentedSource(int scripts)
+{
+	std::string source;
+	for (int i = 0; i < scripts; i++)
+	{
+		std::string n = std::to_string(i);
+		source += "global_" + n + " = " + n + "\n";
+		source += "SCRIPT script_" + n + "\n";
+		source += "local_" + n + " = { a = " + n + " b = \"text\" }\n";
+		source += "IF (<value> == " + n + ")\n";
+		source += "call_" + n + " value = local_" + n + "\n";
+		source += "other_" + n + " = 2\n";
+		source += "ELSE\n";
+		source += "RETURN result = [ 1 2 3 ]\n";
+		source += "ENDIF\n";
+		source += "SWITCH <value>\n";
+		source += "CASE 1\n";
+		source += "case_" + n + " = 1\n";
+		source += "DEFAULT\n";
+		source += "default_" + n + " = 2\n";
+		source += "ENDSWITCH\n";
+		source += "RANDOM(1, 2)\n";
+		source += "RANDOMCASE\n";
+		source += "random_" + n + " = 1\n";
+		source += "RANDOMCASE\n";
+		source += "random_" + n + " = 2\n";
+		source += "RANDOMEND\n";
+		source += "struct_" + n + " = {\n";
+		source += "member_" + n + " = 1\n";
+		source += "}\n";
+		source += "ENDSCRIPT\n";
+		source += "\n";
+	}
+	return source;
+}
+
+static bool SameSourceMap(const QScript::SourceMap &a, const QScript::SourceMap &b)
+{
+	if (a.files != b.files || a.entries.size() != b.entries.size())
+		return false;
+	for (size_t i = 0; i < a.entries.size(); i++)
+	{
+		const auto &x = a.entries[i];
+		const auto &y = b.entries[i];
+		if (x.offset != y.offset || x.file != y.file || x.line != y.line || x.column != y.column)
+			return false;
+	}
+	return true;
+}
+
+static void CheckSame(const std::string &source, QScript::Target target, QScript::CompileOptions options)
+{
+	QScript::CompileResult serial;
+	QScript::Compile(source, target, options, serial);
+
+	// Parallel lexing and emission
+	QScript::CompileOptions parallel_options = options;
+	parallel_options.parallel = true;
+	parallel_options.threads = 4;
+	QScript::CompileResult parallel;
+	QScript::Compile(source, target, parallel_options, parallel);
+	TEST_CHECK(parallel.bytecode == serial.bytecode);
+	TEST_CHECK(SameSourceMap(parallel.source_map, serial.source_map));
+
+	// Cached emission, from an empty cache and again from a warm one
+	QScript::CompileCache cache;
+	QScript::CompileOptions cached_options = options;
+	cached_options.cache = &cache;
+	for (int i = 0; i < 2; i++)
+	{
+		QScript::Stats stats;
+		cached_options.stats = &stats;
+		QScript::CompileResult cached;
+		QScript::Compile(source, target, cached_options, cached);
+		TEST_CHECK(cached.bytecode == serial.bytecode);
+		TEST_CHECK(SameSourceMap(cached.source_map, serial.source_map));
+
+		// Every block emitted on its own, rather than falling back to lexing the whole source
+		TEST_CHECK(stats.source_tokens == 0);
+	}
+}
+
+int main()
+{
+	std::string source = UnindentedSource(64);
+	for (QScript::Target target : { QScript::Target::THUG1, QScript::Target::THUG2 })
+	{
+		QScript::CompileOptions options;
+		CheckSame(source, target, options);
+
+		options.line_numbers = true;
+		CheckSame(source, target, options);
+
+		options.line_numbers = false;
+		options.source_map = true;
+		CheckSame(source, target, options);
+	}
+
+	// A checksum collision is reported with both names, even when the runs that found it first are thrown away
+	{
+		std::string collision = UnindentedSource(16) + "first = n2683599\n" + UnindentedSource(16) + "second = n10000060\n";
+		QScript::CompileCache cache;
+		QScript::CompileOptions options;
+		for (int i = 0; i < 3; i++)
+		{
+			options.parallel = i == 1;
+			options.threads = 4;
+			options.cache = (i == 2) ? &cache : nullptr;
+
+			QScript::CompileResult result;
+			QScript::Error error;
+			TEST_CHECK(!QScript::Compile(collision, QScript::Target::THUG2, options, result, error));
+			TEST_CHECK(error.code == QScript::ErrorCode::ChecksumCollision);
+			TEST_CHECK(error.detail == "n2683599 == n10000060");
+		}
+	}
+
+	return Test::Result();
+}
@@ -0,0 +1,74 @@
+#include <QScript/QCompile.h>
+#include <QScript/QDecompile.h>
+#include <QScript/QVerify.h>
+
+#include <cstddef>
+#include <iostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "QRewrite.h"
+#include "QToken.h"
+#include "Test.h"
+
+// Lines of calls, enough of them to take more than 32 KB of bytecode
+static std::string LargeBody(const std::string &prefix, const char *indent)
+{
+	std::string body;
+	for (int i = 0; i < 2500; i++)
+		body += std::string(indent) + prefix + std::to_string(i) + " value = " + std::to_string(i) + "\n";
+	return body;
+}
+
+// Counts the tokens of a type
+static size_t CountTokens(std::vector<unsigned char> bytecode, QScript::Token token)
+{
+	size_t count = 0;
+	for (const auto &address : QScript::GetTokenAddresses(bytecode, 0, bytecode.size()))
+	{
+		if ((QScript::Token)bytecode[address] == token)
+			count++;
+	}
+	return count;
+}
+
+int main()
+{
+	// An IF body and a SWITCH case too big for short jumps fall back to long blocks, the small IF beside them doesn't
+	std::string source =
+		"SCRIPT large_blocks\n"
+		"\tIF large_if_call\n" +
+		LargeBody("if_call_", "\t\t") +
+		"\tELSE\n"
+		"\t\telse_call\n"
+		"\tENDIF\n"
+		"\tSWITCH <value>\n"
+		"\t\tCASE 1\n" +
+		LargeBody("case_call_", "\t\t\t") +
+		"\t\tDEFAULT\n"
+		"\t\t\tdefault_call\n"
+		"\tENDSWITCH\n"
+		"\tIF small_if_call\n"
+		"\t\tsmall_call\n"
+		"\tENDIF\n"
+		"ENDSCRIPT\n";
+
+	std::vector<unsigned char> bytecode = QScript::Compile(source, QScript::Target::THUG2);
+	std::span<const std::byte> binary((const std::byte *)bytecode.data(), bytecode.size());
+	TEST_CHECK(bytecode.size() > 2 * 0x8000);
+
+	TEST_CHECK(CountTokens(bytecode, QScript::Token::KeywordIf) == 1);
+	TEST_CHECK(CountTokens(bytecode, QScript::Token::FastIf) == 1);
+	TEST_CHECK(CountTokens(bytecode, QScript::Token::ShortJump) == 0);
+
+	// The long blocks verify, and decompile to text that compiles to the same bytecode
+	QScript::Error error;
+	if (!TEST_CHECK(QScript::Verify(binary, error)))
+		std::cerr << error.Message() << std::endl;
+
+	std::string text = QScript::Decompile(binary);
+	TEST_CHECK(QScript::Compile(text, QScript::Target::THUG2) == bytecode);
+
+	return Test::Result();
+}
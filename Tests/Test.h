@@ -0,0 +1,30 @@
+#pragma once
+
+#include <iostream>
+
+// Test checks
+// A failed check is printed and counted, the test keeps going so one run shows every failure
+namespace Test
+{
+	inline int failures = 0;
+
+	inline bool Check(bool condition, const char *expression, const char *file, int line)
+	{
+		if (!condition)
+		{
+			std::cerr << file << ":" << line << ": Check failed: " << expression << std::endl;
+			failures++;
+		}
+		return condition;
+	}
+
+	// Returns the exit code for main
+	inline int Result()
+	{
+		if (failures != 0)
+			std::cerr << failures << " check(s) failed" << std::endl;
+		return (failures != 0) ? 1 : 0;
+	}
+}
+
+#define TEST_CHECK(condition) Test::Check((condition), #condition, __FILE__, __LINE__)